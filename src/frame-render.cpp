@@ -0,0 +1,323 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <graphics/vec4.h>
+
+#include "frame-render.h"
+
+#define FRAME_RENDER_MAX_PLANES 4
+
+struct frame_render_plane {
+	gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct frame_render {
+	gs_effect_t *conversion_effect;
+	gs_texrender_t *texrender;
+	gs_texture_t *textures[FRAME_RENDER_MAX_PLANES];
+	frame_render_plane planes[FRAME_RENDER_MAX_PLANES];
+	size_t plane_count;
+	const char *technique;
+
+	video_format format;
+	uint32_t width;
+	uint32_t height;
+	struct vec4 color_vec[3];
+	float color_range_min[3];
+	float color_range_max[3];
+
+	bool dirty;
+	bool warned_format;
+};
+
+// Mirrors the async texture layout libobs uses for each format, so that
+// the "*_Reverse" techniques of format_conversion.effect can be reused
+// as-is. Returns false for formats the sync path doesn't render.
+static bool get_plane_layout(const struct obs_source_frame *frame,
+			     frame_render_plane *planes, size_t *count,
+			     const char **technique)
+{
+	const uint32_t cx = frame->width;
+	const uint32_t cy = frame->height;
+	const uint32_t half_cx = (cx + 1) / 2;
+	const uint32_t half_cy = (cy + 1) / 2;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_BGRA:
+		planes[0] = {GS_BGRA, cx, cy};
+		*count = 1;
+		*technique = nullptr;
+		return true;
+
+	case VIDEO_FORMAT_BGRX:
+		planes[0] = {GS_BGRX, cx, cy};
+		*count = 1;
+		*technique = nullptr;
+		return true;
+
+	case VIDEO_FORMAT_RGBA:
+		planes[0] = {GS_RGBA, cx, cy};
+		*count = 1;
+		*technique = nullptr;
+		return true;
+
+	case VIDEO_FORMAT_UYVY:
+		planes[0] = {GS_BGRA, half_cx, cy};
+		*count = 1;
+		*technique = "UYVY_Reverse";
+		return true;
+
+	case VIDEO_FORMAT_I420:
+		planes[0] = {GS_R8, cx, cy};
+		planes[1] = {GS_R8, half_cx, half_cy};
+		planes[2] = {GS_R8, half_cx, half_cy};
+		*count = 3;
+		*technique = "I420_Reverse";
+		return true;
+
+	case VIDEO_FORMAT_NV12:
+		planes[0] = {GS_R8, cx, cy};
+		planes[1] = {GS_R8G8, half_cx, half_cy};
+		*count = 2;
+		*technique = "NV12_Reverse";
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static void set_eparam(gs_effect_t *effect, const char *name, float val)
+{
+	gs_eparam_t *param = gs_effect_get_param_by_name(effect, name);
+	if (param)
+		gs_effect_set_float(param, val);
+}
+
+struct frame_render *frame_render_create()
+{
+	auto r = (struct frame_render *)bzalloc(sizeof(struct frame_render));
+
+	char *effect_file = obs_find_data_file("format_conversion.effect");
+	if (effect_file) {
+		r->conversion_effect =
+			gs_effect_create_from_file(effect_file, nullptr);
+		bfree(effect_file);
+	}
+
+	if (!r->conversion_effect)
+		blog(LOG_WARNING,
+		     "frame_render: can't load format_conversion.effect, "
+		     "YUV frames won't be rendered");
+
+	r->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+	return r;
+}
+
+static void free_textures(struct frame_render *r)
+{
+	for (size_t i = 0; i < FRAME_RENDER_MAX_PLANES; ++i) {
+		gs_texture_destroy(r->textures[i]);
+		r->textures[i] = nullptr;
+	}
+	r->plane_count = 0;
+}
+
+void frame_render_destroy(struct frame_render *r)
+{
+	if (!r)
+		return;
+
+	free_textures(r);
+	gs_texrender_destroy(r->texrender);
+	gs_effect_destroy(r->conversion_effect);
+	bfree(r);
+}
+
+bool frame_render_upload(struct frame_render *r,
+			 const struct obs_source_frame *frame)
+{
+	frame_render_plane planes[FRAME_RENDER_MAX_PLANES] = {};
+	size_t count = 0;
+	const char *technique = nullptr;
+
+	if (!get_plane_layout(frame, planes, &count, &technique) ||
+	    (technique && !r->conversion_effect)) {
+		if (!r->warned_format) {
+			blog(LOG_WARNING,
+			     "frame_render: unsupported video format %d",
+			     frame->format);
+			r->warned_format = true;
+		}
+		return false;
+	}
+
+	bool recreate = (count != r->plane_count);
+	for (size_t i = 0; !recreate && i < count; ++i) {
+		recreate = planes[i].format != r->planes[i].format ||
+			   planes[i].width != r->planes[i].width ||
+			   planes[i].height != r->planes[i].height;
+	}
+
+	if (recreate) {
+		free_textures(r);
+		for (size_t i = 0; i < count; ++i) {
+			r->textures[i] = gs_texture_create(
+				planes[i].width, planes[i].height,
+				planes[i].format, 1, nullptr, GS_DYNAMIC);
+			r->planes[i] = planes[i];
+		}
+		r->plane_count = count;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (r->textures[i])
+			gs_texture_set_image(r->textures[i], frame->data[i],
+					     frame->linesize[i], false);
+	}
+
+	r->technique = technique;
+	r->format = frame->format;
+	r->width = frame->width;
+	r->height = frame->height;
+
+	for (size_t i = 0; i < 3; ++i) {
+		vec4_set(&r->color_vec[i], frame->color_matrix[i * 4 + 0],
+			 frame->color_matrix[i * 4 + 1],
+			 frame->color_matrix[i * 4 + 2],
+			 frame->color_matrix[i * 4 + 3]);
+		r->color_range_min[i] = frame->color_range_min[i];
+		r->color_range_max[i] = frame->color_range_max[i];
+	}
+
+	r->dirty = true;
+	return true;
+}
+
+void frame_render_clear(struct frame_render *r)
+{
+	free_textures(r);
+	r->width = 0;
+	r->height = 0;
+	r->technique = nullptr;
+	r->dirty = false;
+}
+
+// Runs the YUV->RGB pass once per uploaded frame, no matter how many
+// times the source is drawn (projectors, multiple scenes...)
+static void convert_if_dirty(struct frame_render *r)
+{
+	if (!r->dirty || !r->technique)
+		return;
+
+	r->dirty = false;
+
+	gs_effect_t *conv = r->conversion_effect;
+	gs_technique_t *tech = gs_effect_get_technique(conv, r->technique);
+	if (!tech)
+		return;
+
+	gs_texrender_reset(r->texrender);
+	if (!gs_texrender_begin(r->texrender, r->width, r->height))
+		return;
+
+	gs_enable_blending(false);
+	gs_technique_begin(tech);
+	gs_technique_begin_pass(tech, 0);
+
+	static const char *image_params[FRAME_RENDER_MAX_PLANES] = {
+		"image", "image1", "image2", "image3"};
+	for (size_t i = 0; i < r->plane_count; ++i) {
+		gs_eparam_t *param =
+			gs_effect_get_param_by_name(conv, image_params[i]);
+		if (param)
+			gs_effect_set_texture(param, r->textures[i]);
+	}
+
+	const float cx = (float)r->width;
+	const float cy = (float)r->height;
+	set_eparam(conv, "width", cx);
+	set_eparam(conv, "height", cy);
+	set_eparam(conv, "width_i", 1.0f / cx);
+	set_eparam(conv, "height_i", 1.0f / cy);
+	set_eparam(conv, "width_d2", cx * 0.5f);
+	set_eparam(conv, "height_d2", cy * 0.5f);
+	set_eparam(conv, "width_x2_i", 0.5f / cx);
+	set_eparam(conv, "height_x2_i", 0.5f / cy);
+
+	static const char *vec_params[3] = {"color_vec0", "color_vec1",
+					    "color_vec2"};
+	for (size_t i = 0; i < 3; ++i) {
+		gs_eparam_t *param =
+			gs_effect_get_param_by_name(conv, vec_params[i]);
+		if (param)
+			gs_effect_set_vec4(param, &r->color_vec[i]);
+	}
+
+	gs_eparam_t *range_min =
+		gs_effect_get_param_by_name(conv, "color_range_min");
+	gs_eparam_t *range_max =
+		gs_effect_get_param_by_name(conv, "color_range_max");
+	if (range_min)
+		gs_effect_set_val(range_min, r->color_range_min,
+				  sizeof(float) * 3);
+	if (range_max)
+		gs_effect_set_val(range_max, r->color_range_max,
+				  sizeof(float) * 3);
+
+	gs_draw(GS_TRIS, 0, 3);
+
+	gs_technique_end_pass(tech);
+	gs_technique_end(tech);
+	gs_enable_blending(true);
+
+	gs_texrender_end(r->texrender);
+}
+
+void frame_render_draw(struct frame_render *r)
+{
+	if (!r || !r->plane_count || !r->textures[0])
+		return;
+
+	convert_if_dirty(r);
+
+	gs_texture_t *tex = r->technique ? gs_texrender_get_texture(r->texrender)
+					 : r->textures[0];
+	if (!tex)
+		return;
+
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, r->width, r->height);
+}
+
+uint32_t frame_render_get_width(const struct frame_render *r)
+{
+	return r ? r->width : 0;
+}
+
+uint32_t frame_render_get_height(const struct frame_render *r)
+{
+	return r ? r->height : 0;
+}
@@ -0,0 +1,37 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+// Uploads obs_source_frame data into textures owned by a synchronous
+// source and converts it to RGB with libobs' format_conversion effect.
+// All functions must be called with the graphics context entered.
+struct frame_render;
+
+struct frame_render *frame_render_create();
+void frame_render_destroy(struct frame_render *r);
+
+bool frame_render_upload(struct frame_render *r,
+			 const struct obs_source_frame *frame);
+void frame_render_clear(struct frame_render *r);
+void frame_render_draw(struct frame_render *r);
+
+uint32_t frame_render_get_width(const struct frame_render *r);
+uint32_t frame_render_get_height(const struct frame_render *r);
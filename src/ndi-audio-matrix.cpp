@@ -0,0 +1,187 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndi-audio-matrix.h"
+#include "ndi-convert.h"
+
+// Samples per channel and block: 8 outputs and 16 inputs of 256 floats
+// stay well inside L1/L2
+#define MATRIX_BLOCK_FRAMES 256
+
+static const char *skip_spaces(const char *p)
+{
+	while (*p && isspace((unsigned char)*p))
+		++p;
+	return p;
+}
+
+// strtod follows the process locale, which OBS sets from the UI language:
+// "0.5" would stop at the dot under a comma decimal separator. The number
+// is delimited here and converted with os_strtod, which always takes a dot.
+static bool parse_gain(const char *p, const char **end, double *gain)
+{
+	char buf[32];
+	size_t len = 0;
+	bool digits = false;
+	bool dot = false;
+
+	if (*p == '+' || *p == '-')
+		buf[len++] = *p++;
+	for (; isdigit((unsigned char)*p) || (*p == '.' && !dot); ++p) {
+		if (len + 1 >= sizeof(buf))
+			return false;
+		digits |= (*p != '.');
+		dot |= (*p == '.');
+		buf[len++] = *p;
+	}
+	if (!digits)
+		return false;
+
+	buf[len] = 0;
+	*gain = os_strtod(buf);
+	*end = p;
+	return true;
+}
+
+static bool parse_term(const char **p, struct ndi_audio_matrix_term *term)
+{
+	char *end = nullptr;
+	const long input = strtol(*p, &end, 10);
+	if (end == *p || input < 1 || input > 1024)
+		return false;
+
+	term->input = (int)input - 1;
+	term->gain = 1.0f;
+
+	const char *cur = skip_spaces(end);
+	if (*cur == '*') {
+		double gain;
+		if (!parse_gain(skip_spaces(cur + 1), &cur, &gain))
+			return false;
+
+		cur = skip_spaces(cur);
+		if ((cur[0] == 'd' || cur[0] == 'D') &&
+		    (cur[1] == 'b' || cur[1] == 'B')) {
+			term->gain = (float)pow(10.0, gain / 20.0);
+			cur = skip_spaces(cur + 2);
+		} else {
+			term->gain = (float)gain;
+		}
+	}
+
+	*p = cur;
+	return true;
+}
+
+bool ndi_audio_matrix_parse(struct ndi_audio_matrix *m, const char *spec)
+{
+	memset(m, 0, sizeof(*m));
+	if (!spec)
+		return true;
+
+	const char *p = skip_spaces(spec);
+	if (!*p)
+		return true;
+
+	for (;;) {
+		if (m->output_count == NDI_AUDIO_MATRIX_MAX_OUTPUTS)
+			goto fail;
+
+		struct ndi_audio_matrix_output *out =
+			&m->outputs[m->output_count++];
+
+		for (;;) {
+			if (out->term_count == NDI_AUDIO_MATRIX_MAX_TERMS)
+				goto fail;
+
+			p = skip_spaces(p);
+			if (!parse_term(&p, &out->terms[out->term_count++]))
+				goto fail;
+			if (*p != '+')
+				break;
+			++p;
+		}
+
+		if (!*p)
+			break;
+		if (*p != ',' && *p != ';' && *p != '\n')
+			goto fail;
+		p = skip_spaces(p + 1);
+	}
+
+	// OBS has no 7 channel layout, 7.1 with a silent last channel is the
+	// closest one
+	if (m->output_count == 7)
+		m->output_count = 8;
+	return true;
+
+fail:
+	memset(m, 0, sizeof(*m));
+	return false;
+}
+
+void ndi_audio_matrix_apply(const struct ndi_audio_matrix *m,
+			    const uint8_t *src, uint32_t channel_stride,
+			    int channels, uint32_t frames, float **dst)
+{
+	for (uint32_t start = 0; start < frames;
+	     start += MATRIX_BLOCK_FRAMES) {
+		const uint32_t count =
+			(frames - start < MATRIX_BLOCK_FRAMES)
+				? frames - start
+				: MATRIX_BLOCK_FRAMES;
+
+		for (size_t o = 0; o < m->output_count; ++o) {
+			const struct ndi_audio_matrix_output *out =
+				&m->outputs[o];
+			float *block = dst[o] + start;
+			bool written = false;
+
+			for (size_t t = 0; t < out->term_count; ++t) {
+				const struct ndi_audio_matrix_term *term =
+					&out->terms[t];
+				if (term->input >= channels)
+					continue;
+
+				const float *in =
+					(const float *)(src +
+							(size_t)term->input *
+								channel_stride) +
+					start;
+				if (written) {
+					ndi_convert_mix_float(in, term->gain,
+							      block, count);
+				} else {
+					ndi_convert_scale_float(
+						in, term->gain, block, count);
+					written = true;
+				}
+			}
+
+			if (!written)
+				memset(block, 0, count * sizeof(float));
+		}
+	}
+}
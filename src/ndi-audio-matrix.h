@@ -0,0 +1,62 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Channel routing and downmix for NDI audio with more channels than OBS
+// can take. Each output channel is a sum of input channels with gains,
+// written as a comma separated list with one entry per output channel:
+//
+//   "1, 2, 3+5*0.5, 4+6*-6dB"
+//
+// Input channels are numbered from 1. Gains are linear factors, or
+// decibels with a "dB" suffix. OBS has no 7 channel speaker layout, so
+// seven outputs get a silent eighth one.
+#define NDI_AUDIO_MATRIX_MAX_OUTPUTS 8
+#define NDI_AUDIO_MATRIX_MAX_TERMS 16
+
+struct ndi_audio_matrix_term {
+	int input;
+	float gain;
+};
+
+struct ndi_audio_matrix_output {
+	size_t term_count;
+	struct ndi_audio_matrix_term terms[NDI_AUDIO_MATRIX_MAX_TERMS];
+};
+
+struct ndi_audio_matrix {
+	size_t output_count;
+	struct ndi_audio_matrix_output outputs[NDI_AUDIO_MATRIX_MAX_OUTPUTS];
+};
+
+// Returns false and leaves an empty matrix on syntax errors. An empty
+// string also gives an empty matrix (output_count == 0).
+bool ndi_audio_matrix_parse(struct ndi_audio_matrix *m, const char *spec);
+
+// Mixes planar float input ('channels' planes 'channel_stride' bytes
+// apart) into the output planes. The samples are processed in blocks
+// small enough to stay in cache, so each input sample is read from
+// memory only once, whatever the number of outputs using it. Inputs
+// missing from the frame are silent.
+void ndi_audio_matrix_apply(const struct ndi_audio_matrix *m,
+			    const uint8_t *src, uint32_t channel_stride,
+			    int channels, uint32_t frames, float **dst);
@@ -0,0 +1,135 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <math.h>
+
+#include "ndi-clock.h"
+
+// Phase and rate gains of the loop. The phase follows 1/64th of every
+// error, which averages the arrival jitter over about a second of frames.
+// The rate is corrected once per CLOCK_RATE_INTERVAL_NS of sender time
+// from the mean error over that interval, normalized by the nominal
+// interval rather than the actual one, so that the loop doesn't depend on
+// how audio and video frames interleave. It settles within a minute, with
+// a rate noise of a few ppm for a few ms of arrival jitter.
+#define CLOCK_PHASE_GAIN (1.0 / 64.0)
+#define CLOCK_RATE_GAIN (1.0 / 1024.0)
+#define CLOCK_RATE_INTERVAL_NS 100000000LL
+// Largest accepted sender clock drift (5000 ppm)
+#define CLOCK_MAX_RATE_ERROR 0.005
+// Errors beyond this are a discontinuity (sender restart, timecode jump,
+// long network stall): the clock restarts from the current frame
+#define CLOCK_JUMP_NS 1000000000.0
+
+void ndi_clock_init(struct ndi_clock *c)
+{
+	pthread_mutex_init(&c->mutex, NULL);
+	c->valid = false;
+	c->rate = 1.0;
+	c->resyncs = 0;
+}
+
+void ndi_clock_free(struct ndi_clock *c)
+{
+	pthread_mutex_destroy(&c->mutex);
+}
+
+void ndi_clock_reset(struct ndi_clock *c)
+{
+	pthread_mutex_lock(&c->mutex);
+	c->valid = false;
+	c->rate = 1.0;
+	pthread_mutex_unlock(&c->mutex);
+}
+
+static inline double predict(const struct ndi_clock *c, int64_t sender_ns)
+{
+	return c->base_local + (double)(sender_ns - c->base_sender) * c->rate;
+}
+
+static void resync(struct ndi_clock *c, int64_t sender_ns, uint64_t local_ns)
+{
+	c->base_sender = sender_ns;
+	c->base_local = (double)local_ns;
+	c->rate_sender = sender_ns;
+	c->error_sum = 0.0;
+	c->error_count = 0;
+	c->rate = 1.0;
+	c->valid = true;
+}
+
+uint64_t ndi_clock_update(struct ndi_clock *c, int64_t sender_ns,
+			  uint64_t local_ns)
+{
+	pthread_mutex_lock(&c->mutex);
+
+	if (!c->valid) {
+		resync(c, sender_ns, local_ns);
+		pthread_mutex_unlock(&c->mutex);
+		return local_ns;
+	}
+
+	const double predicted = predict(c, sender_ns);
+	const double error = (double)local_ns - predicted;
+
+	if (fabs(error) > CLOCK_JUMP_NS) {
+		blog(LOG_INFO,
+		     "NDI clock recovery: %.1f ms discontinuity, resyncing",
+		     error / 1000000.0);
+		c->resyncs++;
+		resync(c, sender_ns, local_ns);
+		pthread_mutex_unlock(&c->mutex);
+		return local_ns;
+	}
+
+	// Audio and video frames arrive interleaved and slightly out of
+	// order, all of them count towards the mean error
+	c->error_sum += error;
+	c->error_count++;
+	if (sender_ns - c->rate_sender >= CLOCK_RATE_INTERVAL_NS) {
+		const double mean = c->error_sum / (double)c->error_count;
+		c->rate += CLOCK_RATE_GAIN * mean /
+			   (double)CLOCK_RATE_INTERVAL_NS;
+		if (c->rate > 1.0 + CLOCK_MAX_RATE_ERROR)
+			c->rate = 1.0 + CLOCK_MAX_RATE_ERROR;
+		else if (c->rate < 1.0 - CLOCK_MAX_RATE_ERROR)
+			c->rate = 1.0 - CLOCK_MAX_RATE_ERROR;
+		c->rate_sender = sender_ns;
+		c->error_sum = 0.0;
+		c->error_count = 0;
+	}
+
+	// Re-anchor on this frame to keep the deltas small
+	c->base_local = predicted + CLOCK_PHASE_GAIN * error;
+	c->base_sender = sender_ns;
+
+	const uint64_t mapped = (uint64_t)c->base_local;
+	pthread_mutex_unlock(&c->mutex);
+	return mapped;
+}
+
+uint64_t ndi_clock_map(struct ndi_clock *c, int64_t sender_ns,
+		       uint64_t fallback_ns)
+{
+	pthread_mutex_lock(&c->mutex);
+	const uint64_t mapped =
+		c->valid ? (uint64_t)predict(c, sender_ns) : fallback_ns;
+	pthread_mutex_unlock(&c->mutex);
+	return mapped;
+}
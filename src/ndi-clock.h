@@ -0,0 +1,54 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <util/threading.h>
+
+// Maps sender time onto os_gettime_ns. Each update compares a sender
+// time with the local time its frame arrived at, and a second order loop
+// (phase and rate) follows the sender clock without the network jitter.
+// Audio and video of a source share one clock, so their timestamps stay
+// consistent with each other.
+struct ndi_clock {
+	pthread_mutex_t mutex;
+	bool valid;
+	int64_t base_sender;
+	double base_local;
+	double rate;
+	// Phase errors since the last rate update, and its sender time
+	int64_t rate_sender;
+	double error_sum;
+	uint32_t error_count;
+	uint64_t resyncs;
+};
+
+void ndi_clock_init(struct ndi_clock *c);
+void ndi_clock_free(struct ndi_clock *c);
+void ndi_clock_reset(struct ndi_clock *c);
+
+// Feeds a sender time (ns) and the local arrival time of its frame, and
+// returns the smoothed local time of that sender time
+uint64_t ndi_clock_update(struct ndi_clock *c, int64_t sender_ns,
+			  uint64_t local_ns);
+
+// Smoothed local time of a sender time, without updating the clock.
+// Sender times before the first update map to 'fallback_ns'.
+uint64_t ndi_clock_map(struct ndi_clock *c, int64_t sender_ns,
+		       uint64_t fallback_ns);
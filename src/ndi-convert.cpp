@@ -0,0 +1,516 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ndi-convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NDI_CONVERT_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NDI_CONVERT_AVX2
+#define NDI_CONVERT_TARGET_AVX2
+#elif defined(__GNUC__) || defined(__clang__)
+#define NDI_CONVERT_AVX2
+#define NDI_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define NDI_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(NDI_CONVERT_AVX2)
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+		return false;
+
+	// AVX2 needs OS support for the YMM state as well
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool has_avx2 = cpu_has_avx2();
+#endif
+
+void ndi_convert_p216_uv_to_p010(const uint8_t *src, uint32_t src_linesize,
+				 uint8_t *dst, uint32_t dst_linesize,
+				 uint32_t width, uint32_t height)
+{
+	// One U,V pair per two luma samples: 'width' 16-bit values per row
+	const uint32_t count = (width + 1) & ~1u;
+	const uint32_t out_height = (height + 1) / 2;
+
+	for (uint32_t y = 0; y < out_height; ++y) {
+		const uint32_t y0 = y * 2;
+		const uint32_t y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+
+		auto row0 = (const uint16_t *)(src + (size_t)y0 * src_linesize);
+		auto row1 = (const uint16_t *)(src + (size_t)y1 * src_linesize);
+		auto out = (uint16_t *)(dst + (size_t)y * dst_linesize);
+
+		uint32_t x = 0;
+#if defined(NDI_CONVERT_SSE2)
+		for (; x + 8 <= count; x += 8) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(row0 + x));
+			__m128i b = _mm_loadu_si128((const __m128i *)(row1 + x));
+			_mm_storeu_si128((__m128i *)(out + x),
+					 _mm_avg_epu16(a, b));
+		}
+#elif defined(NDI_CONVERT_NEON)
+		for (; x + 8 <= count; x += 8) {
+			uint16x8_t a = vld1q_u16(row0 + x);
+			uint16x8_t b = vld1q_u16(row1 + x);
+			vst1q_u16(out + x, vrhaddq_u16(a, b));
+		}
+#endif
+		for (; x < count; ++x)
+			out[x] = (uint16_t)(((uint32_t)row0[x] + row1[x] + 1) >>
+					    1);
+	}
+}
+
+static void uyvy_to_i422_row_c(const uint8_t *src, uint8_t *y, uint8_t *u,
+			       uint8_t *v, uint32_t pairs)
+{
+	for (uint32_t i = 0; i < pairs; ++i) {
+		u[i] = src[0];
+		y[i * 2] = src[1];
+		v[i] = src[2];
+		y[i * 2 + 1] = src[3];
+		src += 4;
+	}
+}
+
+#if defined(NDI_CONVERT_SSE2)
+// 32 pixels (64 bytes) per iteration
+static uint32_t uyvy_to_i422_row_sse2(const uint8_t *src, uint8_t *y,
+				      uint8_t *u, uint8_t *v, uint32_t pairs)
+{
+	const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+	uint32_t i = 0;
+
+	for (; i + 16 <= pairs; i += 16) {
+		const __m128i *in = (const __m128i *)(src + i * 4);
+		__m128i p0 = _mm_loadu_si128(in + 0);
+		__m128i p1 = _mm_loadu_si128(in + 1);
+		__m128i p2 = _mm_loadu_si128(in + 2);
+		__m128i p3 = _mm_loadu_si128(in + 3);
+
+		__m128i y0 = _mm_packus_epi16(_mm_srli_epi16(p0, 8),
+					      _mm_srli_epi16(p1, 8));
+		__m128i y1 = _mm_packus_epi16(_mm_srli_epi16(p2, 8),
+					      _mm_srli_epi16(p3, 8));
+		_mm_storeu_si128((__m128i *)(y + i * 2), y0);
+		_mm_storeu_si128((__m128i *)(y + i * 2 + 16), y1);
+
+		__m128i uv0 = _mm_packus_epi16(_mm_and_si128(p0, low_bytes),
+					       _mm_and_si128(p1, low_bytes));
+		__m128i uv1 = _mm_packus_epi16(_mm_and_si128(p2, low_bytes),
+					       _mm_and_si128(p3, low_bytes));
+
+		__m128i u8 = _mm_packus_epi16(_mm_and_si128(uv0, low_bytes),
+					      _mm_and_si128(uv1, low_bytes));
+		__m128i v8 = _mm_packus_epi16(_mm_srli_epi16(uv0, 8),
+					      _mm_srli_epi16(uv1, 8));
+		_mm_storeu_si128((__m128i *)(u + i), u8);
+		_mm_storeu_si128((__m128i *)(v + i), v8);
+	}
+
+	return i;
+}
+#endif
+
+#if defined(NDI_CONVERT_AVX2)
+// 64 pixels (128 bytes) per iteration. The 256-bit packs work per 128-bit
+// lane, hence the qword permutes to restore the pixel order.
+NDI_CONVERT_TARGET_AVX2
+static uint32_t uyvy_to_i422_row_avx2(const uint8_t *src, uint8_t *y,
+				      uint8_t *u, uint8_t *v, uint32_t pairs)
+{
+	const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+	uint32_t i = 0;
+
+	for (; i + 32 <= pairs; i += 32) {
+		const __m256i *in = (const __m256i *)(src + i * 4);
+		__m256i p0 = _mm256_loadu_si256(in + 0);
+		__m256i p1 = _mm256_loadu_si256(in + 1);
+		__m256i p2 = _mm256_loadu_si256(in + 2);
+		__m256i p3 = _mm256_loadu_si256(in + 3);
+
+		__m256i y0 = _mm256_packus_epi16(_mm256_srli_epi16(p0, 8),
+						 _mm256_srli_epi16(p1, 8));
+		__m256i y1 = _mm256_packus_epi16(_mm256_srli_epi16(p2, 8),
+						 _mm256_srli_epi16(p3, 8));
+		y0 = _mm256_permute4x64_epi64(y0, 0xD8);
+		y1 = _mm256_permute4x64_epi64(y1, 0xD8);
+		_mm256_storeu_si256((__m256i *)(y + i * 2), y0);
+		_mm256_storeu_si256((__m256i *)(y + i * 2 + 32), y1);
+
+		__m256i uv0 = _mm256_packus_epi16(
+			_mm256_and_si256(p0, low_bytes),
+			_mm256_and_si256(p1, low_bytes));
+		__m256i uv1 = _mm256_packus_epi16(
+			_mm256_and_si256(p2, low_bytes),
+			_mm256_and_si256(p3, low_bytes));
+		uv0 = _mm256_permute4x64_epi64(uv0, 0xD8);
+		uv1 = _mm256_permute4x64_epi64(uv1, 0xD8);
+
+		__m256i u8 = _mm256_packus_epi16(
+			_mm256_and_si256(uv0, low_bytes),
+			_mm256_and_si256(uv1, low_bytes));
+		__m256i v8 = _mm256_packus_epi16(_mm256_srli_epi16(uv0, 8),
+						 _mm256_srli_epi16(uv1, 8));
+		u8 = _mm256_permute4x64_epi64(u8, 0xD8);
+		v8 = _mm256_permute4x64_epi64(v8, 0xD8);
+		_mm256_storeu_si256((__m256i *)(u + i), u8);
+		_mm256_storeu_si256((__m256i *)(v + i), v8);
+	}
+
+	return i;
+}
+#endif
+
+#if defined(NDI_CONVERT_NEON)
+// 32 pixels (64 bytes) per iteration, vld4 does the deinterleaving
+static uint32_t uyvy_to_i422_row_neon(const uint8_t *src, uint8_t *y,
+				      uint8_t *u, uint8_t *v, uint32_t pairs)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= pairs; i += 16) {
+		uint8x16x4_t uyvy = vld4q_u8(src + i * 4);
+		uint8x16x2_t yy;
+		yy.val[0] = uyvy.val[1];
+		yy.val[1] = uyvy.val[3];
+		vst2q_u8(y + i * 2, yy);
+		vst1q_u8(u + i, uyvy.val[0]);
+		vst1q_u8(v + i, uyvy.val[2]);
+	}
+
+	return i;
+}
+#endif
+
+void ndi_convert_uyvy_to_i422(const uint8_t *src, uint32_t src_linesize,
+			      uint8_t *dst[3], const uint32_t dst_linesize[3],
+			      uint32_t width, uint32_t height)
+{
+	const uint32_t pairs = width / 2;
+
+	for (uint32_t row = 0; row < height; ++row) {
+		const uint8_t *in = src + (size_t)row * src_linesize;
+		uint8_t *y = dst[0] + (size_t)row * dst_linesize[0];
+		uint8_t *u = dst[1] + (size_t)row * dst_linesize[1];
+		uint8_t *v = dst[2] + (size_t)row * dst_linesize[2];
+
+		uint32_t done = 0;
+#if defined(NDI_CONVERT_AVX2)
+		if (has_avx2)
+			done = uyvy_to_i422_row_avx2(in, y, u, v, pairs);
+#endif
+#if defined(NDI_CONVERT_SSE2)
+		done += uyvy_to_i422_row_sse2(in + done * 4, y + done * 2,
+					      u + done, v + done,
+					      pairs - done);
+#elif defined(NDI_CONVERT_NEON)
+		done = uyvy_to_i422_row_neon(in, y, u, v, pairs);
+#endif
+		uyvy_to_i422_row_c(in + done * 4, y + done * 2, u + done,
+				   v + done, pairs - done);
+
+		// Odd widths: the last pixel still has its own chroma pair
+		if (width & 1) {
+			const uint8_t *last = in + pairs * 4;
+			u[pairs] = last[0];
+			y[width - 1] = last[1];
+			v[pairs] = last[2];
+		}
+	}
+}
+
+void ndi_convert_average_rows(const uint8_t *a, const uint8_t *b, uint8_t *dst,
+			      size_t bytes)
+{
+	size_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_avg_epu8(va, vb));
+	}
+#elif defined(NDI_CONVERT_NEON)
+	for (; i + 16 <= bytes; i += 16)
+		vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+#endif
+	for (; i < bytes; ++i)
+		dst[i] = (uint8_t)((a[i] + b[i] + 1) >> 1);
+}
+
+static inline uint8_t avg_u8(uint8_t a, uint8_t b)
+{
+	return (uint8_t)((a + b + 1) >> 1);
+}
+
+// Averaging the rows first, then the columns, with rounding at each step,
+// matches what the SIMD paths compute
+static inline uint8_t box_u8(const uint8_t *row0, const uint8_t *row1,
+			     size_t a, size_t b)
+{
+	return avg_u8(avg_u8(row0[a], row1[a]), avg_u8(row0[b], row1[b]));
+}
+
+void ndi_convert_halve_rows(const uint8_t *row0, const uint8_t *row1,
+			    uint8_t *dst, uint32_t unit, uint32_t count)
+{
+	uint32_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	// 16 output bytes per iteration
+	const uint32_t step = 16 / unit;
+	for (; i + step <= count; i += step) {
+		const size_t in = (size_t)i * unit * 2;
+		__m128i v0 = _mm_avg_epu8(
+			_mm_loadu_si128((const __m128i *)(row0 + in)),
+			_mm_loadu_si128((const __m128i *)(row1 + in)));
+		__m128i v1 = _mm_avg_epu8(
+			_mm_loadu_si128((const __m128i *)(row0 + in + 16)),
+			_mm_loadu_si128((const __m128i *)(row1 + in + 16)));
+
+		__m128i out;
+		if (unit == 1) {
+			const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+			__m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, low_bytes),
+						   _mm_srli_epi16(v0, 8));
+			__m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, low_bytes),
+						   _mm_srli_epi16(v1, 8));
+			out = _mm_packus_epi16(h0, h1);
+		} else if (unit == 2) {
+			// Result in the low word of each dword, then gathered
+			__m128i h0 = _mm_avg_epu8(v0, _mm_srli_epi32(v0, 16));
+			__m128i h1 = _mm_avg_epu8(v1, _mm_srli_epi32(v1, 16));
+			h0 = _mm_shufflelo_epi16(h0, _MM_SHUFFLE(3, 1, 2, 0));
+			h0 = _mm_shufflehi_epi16(h0, _MM_SHUFFLE(3, 1, 2, 0));
+			h0 = _mm_shuffle_epi32(h0, _MM_SHUFFLE(3, 1, 2, 0));
+			h1 = _mm_shufflelo_epi16(h1, _MM_SHUFFLE(3, 1, 2, 0));
+			h1 = _mm_shufflehi_epi16(h1, _MM_SHUFFLE(3, 1, 2, 0));
+			h1 = _mm_shuffle_epi32(h1, _MM_SHUFFLE(3, 1, 2, 0));
+			out = _mm_unpacklo_epi64(h0, h1);
+		} else {
+			__m128 f0 = _mm_castsi128_ps(v0);
+			__m128 f1 = _mm_castsi128_ps(v1);
+			__m128i even = _mm_castps_si128(
+				_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i odd = _mm_castps_si128(
+				_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+			out = _mm_avg_epu8(even, odd);
+		}
+		_mm_storeu_si128((__m128i *)(dst + (size_t)i * unit), out);
+	}
+#elif defined(NDI_CONVERT_NEON)
+	if (unit == 1) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x2_t a = vld2q_u8(row0 + (size_t)i * 2);
+			uint8x16x2_t b = vld2q_u8(row1 + (size_t)i * 2);
+			vst1q_u8(dst + i,
+				 vrhaddq_u8(vrhaddq_u8(a.val[0], b.val[0]),
+					    vrhaddq_u8(a.val[1], b.val[1])));
+		}
+	} else if (unit == 4) {
+		for (; i + 4 <= count; i += 4) {
+			const size_t in = (size_t)i * 8;
+			auto a0 = (const uint32_t *)(row0 + in);
+			auto b0 = (const uint32_t *)(row1 + in);
+			uint32x4x2_t a = vld2q_u32(a0);
+			uint32x4x2_t b = vld2q_u32(b0);
+			uint8x16_t even =
+				vrhaddq_u8(vreinterpretq_u8_u32(a.val[0]),
+					   vreinterpretq_u8_u32(b.val[0]));
+			uint8x16_t odd =
+				vrhaddq_u8(vreinterpretq_u8_u32(a.val[1]),
+					   vreinterpretq_u8_u32(b.val[1]));
+			vst1q_u8(dst + (size_t)i * 4, vrhaddq_u8(even, odd));
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		const size_t in = (size_t)i * unit * 2;
+		for (uint32_t k = 0; k < unit; ++k)
+			dst[(size_t)i * unit + k] =
+				box_u8(row0, row1, in + k, in + unit + k);
+	}
+}
+
+void ndi_convert_halve_uyvy_rows(const uint8_t *row0, const uint8_t *row1,
+				 uint8_t *dst, uint32_t pairs)
+{
+	uint32_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	// 4 output pairs from 8 input pairs per iteration
+	const __m128i chroma_mask = _mm_set1_epi32(0x00FF00FF);
+	const __m128i low_words = _mm_set1_epi32(0x0000FFFF);
+	for (; i + 4 <= pairs; i += 4) {
+		const size_t in = (size_t)i * 8;
+		__m128i v0 = _mm_avg_epu8(
+			_mm_loadu_si128((const __m128i *)(row0 + in)),
+			_mm_loadu_si128((const __m128i *)(row1 + in)));
+		__m128i v1 = _mm_avg_epu8(
+			_mm_loadu_si128((const __m128i *)(row0 + in + 16)),
+			_mm_loadu_si128((const __m128i *)(row1 + in + 16)));
+
+		// U and V: average of two neighbouring pairs
+		__m128 f0 = _mm_castsi128_ps(v0);
+		__m128 f1 = _mm_castsi128_ps(v1);
+		__m128i even = _mm_castps_si128(
+			_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i odd = _mm_castps_si128(
+			_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+		__m128i chroma = _mm_avg_epu8(even, odd);
+
+		// Y: average of two neighbouring samples, one per word
+		__m128i y0 = _mm_srli_epi16(v0, 8);
+		__m128i y1 = _mm_srli_epi16(v1, 8);
+		y0 = _mm_avg_epu16(_mm_and_si128(y0, low_words),
+				   _mm_srli_epi32(y0, 16));
+		y1 = _mm_avg_epu16(_mm_and_si128(y1, low_words),
+				   _mm_srli_epi32(y1, 16));
+		__m128i luma = _mm_slli_epi16(_mm_packs_epi32(y0, y1), 8);
+
+		_mm_storeu_si128((__m128i *)(dst + (size_t)i * 4),
+				 _mm_or_si128(_mm_and_si128(chroma, chroma_mask),
+					      luma));
+	}
+#endif
+	for (; i < pairs; ++i) {
+		const size_t in = (size_t)i * 8;
+		uint8_t *out = dst + (size_t)i * 4;
+		out[0] = box_u8(row0, row1, in + 0, in + 4);
+		out[1] = box_u8(row0, row1, in + 1, in + 3);
+		out[2] = box_u8(row0, row1, in + 2, in + 6);
+		out[3] = box_u8(row0, row1, in + 5, in + 7);
+	}
+}
+
+void ndi_convert_motion_adaptive_row(const uint8_t *cur, const uint8_t *prev,
+				     const uint8_t *above,
+				     const uint8_t *below, uint8_t *dst,
+				     size_t bytes, uint8_t threshold)
+{
+	size_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	const __m128i limit = _mm_set1_epi8((char)threshold);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(cur + i));
+		__m128i p = _mm_loadu_si128((const __m128i *)(prev + i));
+		__m128i a = _mm_loadu_si128((const __m128i *)(above + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(below + i));
+
+		__m128i diff = _mm_or_si128(_mm_subs_epu8(c, p),
+					    _mm_subs_epu8(p, c));
+		// All ones where the pixel didn't move
+		__m128i still =
+			_mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero);
+		__m128i interp = _mm_avg_epu8(a, b);
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_or_si128(_mm_and_si128(still, c),
+					      _mm_andnot_si128(still, interp)));
+	}
+#elif defined(NDI_CONVERT_NEON)
+	const uint8x16_t limit = vdupq_n_u8(threshold);
+	for (; i + 16 <= bytes; i += 16) {
+		uint8x16_t c = vld1q_u8(cur + i);
+		uint8x16_t p = vld1q_u8(prev + i);
+		uint8x16_t interp =
+			vrhaddq_u8(vld1q_u8(above + i), vld1q_u8(below + i));
+		uint8x16_t still = vcleq_u8(vabdq_u8(c, p), limit);
+		vst1q_u8(dst + i, vbslq_u8(still, c, interp));
+	}
+#endif
+	for (; i < bytes; ++i) {
+		const int diff = cur[i] > prev[i] ? cur[i] - prev[i]
+						  : prev[i] - cur[i];
+		dst[i] = diff <= threshold
+				 ? cur[i]
+				 : (uint8_t)((above[i] + below[i] + 1) >> 1);
+	}
+}
+
+void ndi_convert_scale_float(const float *src, float gain, float *dst,
+			     size_t count)
+{
+	size_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	const __m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_loadu_ps(src + i);
+		__m128 b = _mm_loadu_ps(src + i + 4);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(a, g));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(b, g));
+	}
+#elif defined(NDI_CONVERT_NEON)
+	for (; i + 8 <= count; i += 8) {
+		vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(src + i), gain));
+		vst1q_f32(dst + i + 4,
+			  vmulq_n_f32(vld1q_f32(src + i + 4), gain));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = src[i] * gain;
+}
+
+void ndi_convert_mix_float(const float *src, float gain, float *dst,
+			   size_t count)
+{
+	size_t i = 0;
+#if defined(NDI_CONVERT_SSE2)
+	const __m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_loadu_ps(src + i);
+		__m128 b = _mm_loadu_ps(src + i + 4);
+		__m128 da = _mm_loadu_ps(dst + i);
+		__m128 db = _mm_loadu_ps(dst + i + 4);
+		_mm_storeu_ps(dst + i, _mm_add_ps(da, _mm_mul_ps(a, g)));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(db, _mm_mul_ps(b, g)));
+	}
+#elif defined(NDI_CONVERT_NEON)
+	for (; i + 8 <= count; i += 8) {
+		vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i),
+					       vld1q_f32(src + i), gain));
+		vst1q_f32(dst + i + 4,
+			  vmlaq_n_f32(vld1q_f32(dst + i + 4),
+				      vld1q_f32(src + i + 4), gain));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] += src[i] * gain;
+}
@@ -0,0 +1,69 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pixel repacking kernels used on the receive threads. Each has a SIMD
+// implementation where available and a scalar fallback.
+
+// Turns the 4:2:2 interleaved 16-bit UV plane of a P216 frame into the
+// 4:2:0 UV plane of a P010 frame by averaging pairs of rows. The luma
+// plane has the same layout in both formats and is used as-is.
+void ndi_convert_p216_uv_to_p010(const uint8_t *src, uint32_t src_linesize,
+				 uint8_t *dst, uint32_t dst_linesize,
+				 uint32_t width, uint32_t height);
+
+// Splits packed UYVY rows into the Y, U and V planes of an I422 frame.
+// Used for UYVA frames, whose alpha plane can then be handed to libobs
+// untouched as the fourth plane of an I42A frame.
+void ndi_convert_uyvy_to_i422(const uint8_t *src, uint32_t src_linesize,
+			      uint8_t *dst[3], const uint32_t dst_linesize[3],
+			      uint32_t width, uint32_t height);
+
+// Byte-wise rounded average of two rows, used to rebuild the missing lines
+// of a field. Only meaningful for 8-bit formats.
+void ndi_convert_average_rows(const uint8_t *a, const uint8_t *b, uint8_t *dst,
+			      size_t bytes);
+
+// Motion adaptive line of an 8-bit frame: keeps 'cur' wherever it is
+// within 'threshold' of the same line in the previous frame, and takes the
+// average of the lines above and below elsewhere.
+void ndi_convert_motion_adaptive_row(const uint8_t *cur, const uint8_t *prev,
+				     const uint8_t *above,
+				     const uint8_t *below, uint8_t *dst,
+				     size_t bytes, uint8_t threshold);
+
+// 2x2 box downscale of a pair of 8-bit rows. Each output element is the
+// average of two adjacent 'unit'-byte elements of both rows: 1 for planar
+// samples, 2 for NV12 UV pairs, 4 for RGBA pixels. 'count' is the number
+// of output elements.
+void ndi_convert_halve_rows(const uint8_t *row0, const uint8_t *row1,
+			    uint8_t *dst, uint32_t unit, uint32_t count);
+
+// Same for packed UYVY rows, 'pairs' output pixel pairs from twice as many
+void ndi_convert_halve_uyvy_rows(const uint8_t *row0, const uint8_t *row1,
+				 uint8_t *dst, uint32_t pairs);
+
+// Planar float audio: dst = src * gain, and dst += src * gain
+void ndi_convert_scale_float(const float *src, float gain, float *dst,
+			     size_t count);
+void ndi_convert_mix_float(const float *src, float gain, float *dst,
+			   size_t count);
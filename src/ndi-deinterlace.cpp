@@ -0,0 +1,435 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <string.h>
+
+#include "ndi-deinterlace.h"
+#include "ndi-convert.h"
+
+// Per-byte difference above which a pixel is considered moving
+#define NDI_DEINTERLACE_MOTION_THRESHOLD 12
+#define NDI_DEINTERLACE_MAX_PLANES 2
+
+struct plane_view {
+	uint8_t *data[NDI_DEINTERLACE_MAX_PLANES];
+	uint32_t stride[NDI_DEINTERLACE_MAX_PLANES];
+	uint32_t rows;
+};
+
+struct ndi_deinterlacer {
+	enum ndi_deinterlace_mode mode;
+	NDIlib_FourCC_video_type_e fourcc;
+	uint32_t width;
+	uint32_t height;
+	size_t plane_count;
+	uint32_t row_bytes[NDI_DEINTERLACE_MAX_PLANES];
+
+	// Full height frames, planes stored back to back without padding
+	uint8_t *woven;
+	uint8_t *prev;
+	uint8_t *out;
+
+	// Field 0 waiting in 'woven' for its field 1
+	bool have_field0;
+	NDIlib_video_frame_v2_t field0;
+
+	// 'prev' holds the previous woven frame (adaptive mode)
+	bool have_prev;
+
+	bool warned_format;
+};
+
+static size_t get_row_bytes(NDIlib_FourCC_video_type_e fourcc, uint32_t width,
+			    uint32_t *row_bytes)
+{
+	switch (fourcc) {
+	case NDIlib_FourCC_type_UYVY:
+		row_bytes[0] = width * 2;
+		return 1;
+
+	case NDIlib_FourCC_type_UYVA:
+		row_bytes[0] = width * 2;
+		row_bytes[1] = width;
+		return 2;
+
+	case NDIlib_FourCC_type_BGRA:
+	case NDIlib_FourCC_type_BGRX:
+	case NDIlib_FourCC_type_RGBA:
+	case NDIlib_FourCC_type_RGBX:
+		row_bytes[0] = width * 4;
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+static uint32_t field_rows(uint32_t height, int parity)
+{
+	return parity ? height / 2 : (height + 1) / 2;
+}
+
+struct ndi_deinterlacer *ndi_deinterlacer_create()
+{
+	return (struct ndi_deinterlacer *)bzalloc(
+		sizeof(struct ndi_deinterlacer));
+}
+
+static void free_buffers(struct ndi_deinterlacer *d)
+{
+	bfree(d->woven);
+	bfree(d->prev);
+	bfree(d->out);
+	d->woven = nullptr;
+	d->prev = nullptr;
+	d->out = nullptr;
+}
+
+void ndi_deinterlacer_destroy(struct ndi_deinterlacer *d)
+{
+	if (!d)
+		return;
+
+	free_buffers(d);
+	bfree(d);
+}
+
+static void reset(struct ndi_deinterlacer *d,
+		  const NDIlib_video_frame_v2_t *frame,
+		  const uint32_t *row_bytes, size_t plane_count)
+{
+	free_buffers(d);
+
+	d->fourcc = frame->FourCC;
+	d->width = (uint32_t)frame->xres;
+	d->height = (uint32_t)frame->yres;
+	d->plane_count = plane_count;
+
+	size_t size = 0;
+	for (size_t i = 0; i < plane_count; ++i) {
+		d->row_bytes[i] = row_bytes[i];
+		size += (size_t)row_bytes[i] * d->height;
+	}
+
+	d->woven = (uint8_t *)bmalloc(size);
+	d->prev = (uint8_t *)bmalloc(size);
+	d->out = (uint8_t *)bmalloc(size);
+	d->have_field0 = false;
+	d->have_prev = false;
+}
+
+// View of the received data. For field frames, 'rows' is the number of
+// lines of that field.
+static void frame_view(const struct ndi_deinterlacer *d,
+		       const NDIlib_video_frame_v2_t *frame, uint32_t rows,
+		       struct plane_view *view)
+{
+	uint32_t stride = (uint32_t)frame->line_stride_in_bytes;
+	if (!stride)
+		stride = d->row_bytes[0];
+
+	view->data[0] = frame->p_data;
+	view->stride[0] = stride;
+	view->rows = rows;
+
+	// UYVA: the alpha plane follows the UYVY lines
+	if (d->plane_count > 1) {
+		view->data[1] = frame->p_data + (size_t)stride * rows;
+		view->stride[1] = d->row_bytes[1];
+	}
+}
+
+static void buffer_view(const struct ndi_deinterlacer *d, uint8_t *buffer,
+			struct plane_view *view)
+{
+	for (size_t i = 0; i < d->plane_count; ++i) {
+		view->data[i] = buffer;
+		view->stride[i] = d->row_bytes[i];
+		buffer += (size_t)d->row_bytes[i] * d->height;
+	}
+	view->rows = d->height;
+}
+
+static void field_of(const struct ndi_deinterlacer *d,
+		     const struct plane_view *full, int parity,
+		     struct plane_view *field)
+{
+	for (size_t i = 0; i < d->plane_count; ++i) {
+		field->data[i] = full->data[i] + parity * full->stride[i];
+		field->stride[i] = full->stride[i] * 2;
+	}
+	field->rows = field_rows(full->rows, parity);
+}
+
+static inline uint8_t *row(const struct plane_view *view, size_t plane,
+			   uint32_t y)
+{
+	return view->data[plane] + (size_t)y * view->stride[plane];
+}
+
+static void weave_field(const struct ndi_deinterlacer *d,
+			const struct plane_view *field, int parity,
+			const struct plane_view *dst)
+{
+	for (size_t i = 0; i < d->plane_count; ++i) {
+		for (uint32_t r = 0; r < field->rows; ++r) {
+			const uint32_t y = r * 2 + parity;
+			if (y >= dst->rows)
+				break;
+			memcpy(row(dst, i, y), row(field, i, r),
+			       d->row_bytes[i]);
+		}
+	}
+}
+
+// Line doubling with linear interpolation of the missing lines
+static void bob_field(const struct ndi_deinterlacer *d,
+		      const struct plane_view *field, int parity,
+		      const struct plane_view *dst)
+{
+	if (!field->rows)
+		return;
+
+	for (size_t i = 0; i < d->plane_count; ++i) {
+		for (uint32_t y = 0; y < dst->rows; ++y) {
+			if ((int)(y & 1) == parity) {
+				memcpy(row(dst, i, y), row(field, i, y / 2),
+				       d->row_bytes[i]);
+				continue;
+			}
+
+			// Field lines above and below, clamped to the field
+			const uint32_t above =
+				(y > 0) ? (y - 1) / 2 : 0;
+			uint32_t below = (y + 1 - parity) / 2;
+			if (below >= field->rows)
+				below = field->rows - 1;
+
+			ndi_convert_average_rows(row(field, i, above),
+						 row(field, i, below),
+						 row(dst, i, y),
+						 d->row_bytes[i]);
+		}
+	}
+}
+
+static void adaptive_frame(const struct ndi_deinterlacer *d,
+			   const struct plane_view *cur,
+			   const struct plane_view *prev,
+			   const struct plane_view *dst)
+{
+	for (size_t i = 0; i < d->plane_count; ++i) {
+		for (uint32_t y = 0; y < dst->rows; ++y) {
+			if (!(y & 1)) {
+				memcpy(row(dst, i, y), row(cur, i, y),
+				       d->row_bytes[i]);
+				continue;
+			}
+
+			const uint32_t below =
+				(y + 1 < dst->rows) ? y + 1 : y - 1;
+			ndi_convert_motion_adaptive_row(
+				row(cur, i, y), row(prev, i, y),
+				row(cur, i, y - 1), row(cur, i, below),
+				row(dst, i, y), d->row_bytes[i],
+				NDI_DEINTERLACE_MOTION_THRESHOLD);
+		}
+	}
+}
+
+static void emit(const struct ndi_deinterlacer *d,
+		 const NDIlib_video_frame_v2_t *info, uint8_t *buffer,
+		 int64_t offset, ndi_deinterlace_output_cb output, void *param)
+{
+	NDIlib_video_frame_v2_t frame = *info;
+	frame.p_data = buffer;
+	frame.line_stride_in_bytes = (int)d->row_bytes[0];
+	frame.frame_format_type = NDIlib_frame_format_type_progressive;
+	frame.p_metadata = nullptr;
+
+	if (offset) {
+		frame.timecode += offset;
+		if (frame.timestamp != NDIlib_recv_timestamp_undefined)
+			frame.timestamp += offset;
+	}
+
+	output(param, &frame);
+}
+
+// Half a frame, in 100 ns units
+static int64_t field_duration(const NDIlib_video_frame_v2_t *frame)
+{
+	if (frame->frame_rate_N <= 0)
+		return 0;
+	return (int64_t)frame->frame_rate_D * 10000000 / frame->frame_rate_N /
+	       2;
+}
+
+static void process_interleaved(struct ndi_deinterlacer *d,
+				const NDIlib_video_frame_v2_t *frame,
+				ndi_deinterlace_output_cb output, void *param)
+{
+	struct plane_view full = {};
+	struct plane_view field = {};
+	struct plane_view out = {};
+	struct plane_view prev = {};
+
+	frame_view(d, frame, d->height, &full);
+	buffer_view(d, d->out, &out);
+
+	switch (d->mode) {
+	case NDI_DEINTERLACE_BOB:
+		field_of(d, &full, 0, &field);
+		bob_field(d, &field, 0, &out);
+		emit(d, frame, d->out, 0, output, param);
+
+		field_of(d, &full, 1, &field);
+		bob_field(d, &field, 1, &out);
+		emit(d, frame, d->out, field_duration(frame), output, param);
+		break;
+
+	case NDI_DEINTERLACE_ADAPTIVE:
+		buffer_view(d, d->prev, &prev);
+		if (d->have_prev) {
+			adaptive_frame(d, &full, &prev, &out);
+			emit(d, frame, d->out, 0, output, param);
+		} else {
+			emit(d, frame, frame->p_data, 0, output, param);
+		}
+
+		field_of(d, &full, 0, &field);
+		weave_field(d, &field, 0, &prev);
+		field_of(d, &full, 1, &field);
+		weave_field(d, &field, 1, &prev);
+		d->have_prev = true;
+		break;
+
+	default: {
+		// Weave: the frame already holds both fields
+		NDIlib_video_frame_v2_t progressive = *frame;
+		progressive.frame_format_type =
+			NDIlib_frame_format_type_progressive;
+		output(param, &progressive);
+		break;
+	}
+	}
+}
+
+static void process_field(struct ndi_deinterlacer *d,
+			  const NDIlib_video_frame_v2_t *frame, int parity,
+			  ndi_deinterlace_output_cb output, void *param)
+{
+	struct plane_view field = {};
+	struct plane_view woven = {};
+	struct plane_view out = {};
+
+	frame_view(d, frame, field_rows(d->height, parity), &field);
+
+	if (d->mode == NDI_DEINTERLACE_BOB) {
+		buffer_view(d, d->out, &out);
+		bob_field(d, &field, parity, &out);
+		emit(d, frame, d->out, 0, output, param);
+		return;
+	}
+
+	buffer_view(d, d->woven, &woven);
+	weave_field(d, &field, parity, &woven);
+
+	if (parity == 0) {
+		d->field0 = *frame;
+		d->have_field0 = true;
+		return;
+	}
+
+	// Field 1 without a preceding field 0 (stream start, drop)
+	if (!d->have_field0)
+		return;
+	d->have_field0 = false;
+
+	if (d->mode == NDI_DEINTERLACE_ADAPTIVE) {
+		if (d->have_prev) {
+			struct plane_view prev = {};
+			buffer_view(d, d->prev, &prev);
+			buffer_view(d, d->out, &out);
+			adaptive_frame(d, &woven, &prev, &out);
+			emit(d, &d->field0, d->out, 0, output, param);
+		} else {
+			emit(d, &d->field0, d->woven, 0, output, param);
+		}
+
+		uint8_t *tmp = d->prev;
+		d->prev = d->woven;
+		d->woven = tmp;
+		d->have_prev = true;
+		return;
+	}
+
+	emit(d, &d->field0, d->woven, 0, output, param);
+}
+
+void ndi_deinterlacer_process(struct ndi_deinterlacer *d,
+			      enum ndi_deinterlace_mode mode,
+			      const NDIlib_video_frame_v2_t *frame,
+			      ndi_deinterlace_output_cb output, void *param)
+{
+	if (mode == NDI_DEINTERLACE_OFF ||
+	    frame->frame_format_type == NDIlib_frame_format_type_progressive) {
+		output(param, frame);
+		return;
+	}
+
+	uint32_t row_bytes[NDI_DEINTERLACE_MAX_PLANES] = {};
+	const size_t plane_count =
+		get_row_bytes(frame->FourCC, (uint32_t)frame->xres, row_bytes);
+	if (!plane_count || frame->xres <= 0 || frame->yres <= 0) {
+		if (!d->warned_format) {
+			blog(LOG_WARNING,
+			     "deinterlace: pixel format %d not supported, "
+			     "fields are passed through",
+			     frame->FourCC);
+			d->warned_format = true;
+		}
+		output(param, frame);
+		return;
+	}
+
+	if (frame->FourCC != d->fourcc || (uint32_t)frame->xres != d->width ||
+	    (uint32_t)frame->yres != d->height || !d->woven)
+		reset(d, frame, row_bytes, plane_count);
+
+	if (mode != d->mode) {
+		d->mode = mode;
+		d->have_field0 = false;
+		d->have_prev = false;
+	}
+
+	switch (frame->frame_format_type) {
+	case NDIlib_frame_format_type_field_0:
+		process_field(d, frame, 0, output, param);
+		break;
+
+	case NDIlib_frame_format_type_field_1:
+		process_field(d, frame, 1, output, param);
+		break;
+
+	default:
+		process_interleaved(d, frame, output, param);
+		break;
+	}
+}
@@ -0,0 +1,52 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "obs-ndi.h"
+
+// Receive-side handling of interlaced NDI video. Field frames and
+// interleaved frames are turned into progressive frames before they reach
+// libobs, so that no GPU deinterlacing pass is needed when rendering.
+enum ndi_deinterlace_mode {
+	// Frames are passed on as they are received
+	NDI_DEINTERLACE_OFF = 0,
+	// Both fields of a frame form one progressive frame
+	NDI_DEINTERLACE_WEAVE,
+	// Every field is line doubled into its own frame (field rate output)
+	NDI_DEINTERLACE_BOB,
+	// Weave, with the second field interpolated where there is motion
+	NDI_DEINTERLACE_ADAPTIVE,
+};
+
+struct ndi_deinterlacer;
+
+typedef void (*ndi_deinterlace_output_cb)(void *param,
+					  const NDIlib_video_frame_v2_t *frame);
+
+struct ndi_deinterlacer *ndi_deinterlacer_create();
+void ndi_deinterlacer_destroy(struct ndi_deinterlacer *d);
+
+// Calls 'output' zero, one or two times with progressive frames. Frames
+// produced by the deinterlacer are only valid during the callback.
+// Progressive frames, and pixel formats other than 8-bit UYVY/UYVA/RGB,
+// are passed through.
+void ndi_deinterlacer_process(struct ndi_deinterlacer *d,
+			      enum ndi_deinterlace_mode mode,
+			      const NDIlib_video_frame_v2_t *frame,
+			      ndi_deinterlace_output_cb output, void *param);
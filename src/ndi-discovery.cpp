@@ -0,0 +1,176 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "ndi-discovery.h"
+
+// Upper bound of a find_wait_for_sources call, and so of shutdown
+#define DISCOVERY_WAIT_MS 500
+
+static NDIlib_find_instance_t discovery_finder;
+static pthread_t discovery_thread;
+static std::atomic<bool> discovery_running;
+
+// Sorted and unique: prefix lookups are a binary search
+static pthread_mutex_t discovery_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<std::string> discovery_names;
+static uint64_t discovery_gen;
+
+static void ndi_discovery_scan()
+{
+	uint32_t count = 0;
+	const NDIlib_source_t *sources =
+		ndiLib->find_get_current_sources(discovery_finder, &count);
+
+	std::vector<std::string> names;
+	names.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (sources[i].p_ndi_name && *sources[i].p_ndi_name)
+			names.emplace_back(sources[i].p_ndi_name);
+	}
+
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+
+	pthread_mutex_lock(&discovery_mutex);
+	const bool changed = !discovery_gen || names != discovery_names;
+	if (changed) {
+		discovery_names.swap(names);
+		discovery_gen++;
+	}
+	const uint64_t gen = discovery_gen;
+	const size_t total = discovery_names.size();
+	pthread_mutex_unlock(&discovery_mutex);
+
+	if (!changed)
+		return;
+
+	blog(LOG_DEBUG, "NDI discovery: %zu sources", total);
+
+	uint8_t stack[128];
+	struct calldata cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "generation", (long long)gen);
+	signal_handler_signal(obs_get_signal_handler(), "ndi_sources_changed",
+			      &cd);
+}
+
+static void *ndi_discovery_thread(void *)
+{
+	os_set_thread_name("NDI discovery");
+
+	// The finder may already know sources from before we started
+	ndi_discovery_scan();
+
+	while (discovery_running) {
+		if (ndiLib->find_wait_for_sources(discovery_finder,
+						  DISCOVERY_WAIT_MS))
+			ndi_discovery_scan();
+	}
+
+	return nullptr;
+}
+
+uint64_t ndi_discovery_generation()
+{
+	pthread_mutex_lock(&discovery_mutex);
+	const uint64_t gen = discovery_gen;
+	pthread_mutex_unlock(&discovery_mutex);
+	return gen;
+}
+
+size_t ndi_discovery_enum(const char *prefix, ndi_discovery_enum_cb cb,
+			  void *param)
+{
+	const std::string p = prefix ? prefix : "";
+	size_t count = 0;
+
+	pthread_mutex_lock(&discovery_mutex);
+	auto it = std::lower_bound(discovery_names.begin(),
+				   discovery_names.end(), p);
+	for (; it != discovery_names.end() && it->compare(0, p.size(), p) == 0;
+	     ++it) {
+		cb(param, it->c_str());
+		count++;
+	}
+	pthread_mutex_unlock(&discovery_mutex);
+
+	return count;
+}
+
+static void ndi_discovery_get_sources_proc(void *, calldata_t *cd)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	ndi_discovery_enum(
+		calldata_string(cd, "prefix"),
+		[](void *param, const char *name) {
+			obs_data_t *item = obs_data_create();
+			obs_data_set_string(item, "name", name);
+			obs_data_array_push_back((obs_data_array_t *)param,
+						 item);
+			obs_data_release(item);
+		},
+		array);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_set_array(data, "sources", array);
+	obs_data_set_int(data, "generation",
+			 (long long)ndi_discovery_generation());
+	calldata_set_string(cd, "sources", obs_data_get_json(data));
+	obs_data_release(data);
+	obs_data_array_release(array);
+}
+
+void ndi_discovery_init(NDIlib_find_instance_t finder)
+{
+	if (!finder)
+		return;
+
+	signal_handler_add(obs_get_signal_handler(),
+			   "void ndi_sources_changed(int generation)");
+	proc_handler_add(obs_get_proc_handler(),
+			 "void ndi_get_sources(in string prefix, "
+			 "out string sources)",
+			 ndi_discovery_get_sources_proc, nullptr);
+
+	discovery_finder = finder;
+	discovery_running = true;
+	if (pthread_create(&discovery_thread, nullptr, ndi_discovery_thread,
+			   nullptr) != 0)
+		discovery_running = false;
+}
+
+void ndi_discovery_shutdown()
+{
+	if (discovery_running) {
+		discovery_running = false;
+		pthread_join(discovery_thread, nullptr);
+	}
+
+	pthread_mutex_lock(&discovery_mutex);
+	discovery_names.clear();
+	discovery_gen = 0;
+	pthread_mutex_unlock(&discovery_mutex);
+}
@@ -0,0 +1,45 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "obs-ndi.h"
+
+// NDI source discovery. A background thread follows the finder and keeps
+// a sorted, deduplicated list of source names, so that property lists and
+// scripts never wait on the network.
+//
+// Whenever the list changes, the global "ndi_sources_changed" signal is
+// emitted with the new generation. The global "ndi_get_sources" procedure
+// returns the names starting with an optional prefix, as JSON.
+void ndi_discovery_init(NDIlib_find_instance_t finder);
+void ndi_discovery_shutdown();
+
+// Bumped on every change of the list, 0 until the first scan
+uint64_t ndi_discovery_generation();
+
+// Calls 'cb' in order for every known name starting with 'prefix' (every
+// name when null or empty) and returns how many there were. The list is
+// locked meanwhile, callbacks must not call back into discovery.
+typedef void (*ndi_discovery_enum_cb)(void *param, const char *name);
+
+size_t ndi_discovery_enum(const char *prefix, ndi_discovery_enum_cb cb,
+			  void *param);
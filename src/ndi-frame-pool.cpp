@@ -0,0 +1,226 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <util/threading.h>
+#include <atomic>
+#include <cstring>
+
+#include "ndi-frame-pool.h"
+
+struct ndi_frame_pool {
+	pthread_mutex_t mutex;
+	struct ndi_frame_layout layout;
+	struct ndi_pooled_frame *free_frames;
+	std::atomic<uint64_t> allocations;
+};
+
+static inline uint32_t align_size(uint32_t size)
+{
+	return (size + NDI_FRAME_POOL_ALIGN - 1) & ~(NDI_FRAME_POOL_ALIGN - 1);
+}
+
+bool ndi_frame_layout_for_format(struct ndi_frame_layout *layout,
+				 enum video_format format, uint32_t width,
+				 uint32_t height)
+{
+	const uint32_t half_width = (width + 1) / 2;
+	const uint32_t half_height = (height + 1) / 2;
+
+	memset(layout, 0, sizeof(*layout));
+
+	switch (format) {
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_RGBA:
+		*layout = {1, {width * 4}, {height}};
+		return true;
+
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_YUY2:
+		*layout = {1, {half_width * 4}, {height}};
+		return true;
+
+	case VIDEO_FORMAT_I420:
+		*layout = {3,
+			   {width, half_width, half_width},
+			   {height, half_height, half_height}};
+		return true;
+
+	case VIDEO_FORMAT_NV12:
+		*layout = {2, {width, half_width * 2}, {height, half_height}};
+		return true;
+
+	case VIDEO_FORMAT_I422:
+		*layout = {3,
+			   {width, half_width, half_width},
+			   {height, height, height}};
+		return true;
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(26, 1, 0)
+	case VIDEO_FORMAT_I42A:
+		*layout = {4,
+			   {width, half_width, half_width, width},
+			   {height, height, height, height}};
+		return true;
+#endif
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+	case VIDEO_FORMAT_P010:
+		*layout = {2,
+			   {width * 2, half_width * 4},
+			   {height, half_height}};
+		return true;
+#endif
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(29, 1, 0)
+	case VIDEO_FORMAT_P216:
+		*layout = {2, {width * 2, half_width * 4}, {height, height}};
+		return true;
+#endif
+
+	default:
+		return false;
+	}
+}
+
+static bool same_layout(const struct ndi_frame_layout *a,
+			const struct ndi_frame_layout *b)
+{
+	if (a->plane_count != b->plane_count)
+		return false;
+
+	for (uint32_t i = 0; i < a->plane_count; ++i) {
+		if (a->row_bytes[i] != b->row_bytes[i] ||
+		    a->rows[i] != b->rows[i])
+			return false;
+	}
+	return true;
+}
+
+static void free_frame(struct ndi_pooled_frame *frame)
+{
+	bfree(frame->buffer);
+	bfree(frame);
+}
+
+static struct ndi_pooled_frame *
+alloc_frame(const struct ndi_frame_layout *layout)
+{
+	auto frame = (struct ndi_pooled_frame *)bzalloc(
+		sizeof(struct ndi_pooled_frame));
+	frame->layout = *layout;
+
+	size_t size = 0;
+	for (uint32_t i = 0; i < layout->plane_count; ++i) {
+		frame->linesize[i] = align_size(layout->row_bytes[i]);
+		size += (size_t)frame->linesize[i] * layout->rows[i];
+	}
+
+	// bmalloc only guarantees 16 or 32 bytes
+	frame->buffer = (uint8_t *)bmalloc(size + NDI_FRAME_POOL_ALIGN);
+	uintptr_t addr = (uintptr_t)frame->buffer;
+	addr = (addr + NDI_FRAME_POOL_ALIGN - 1) &
+	       ~(uintptr_t)(NDI_FRAME_POOL_ALIGN - 1);
+
+	uint8_t *plane = (uint8_t *)addr;
+	for (uint32_t i = 0; i < layout->plane_count; ++i) {
+		frame->data[i] = plane;
+		plane += (size_t)frame->linesize[i] * layout->rows[i];
+	}
+	return frame;
+}
+
+struct ndi_frame_pool *ndi_frame_pool_create()
+{
+	auto pool = (struct ndi_frame_pool *)bzalloc(
+		sizeof(struct ndi_frame_pool));
+	pthread_mutex_init(&pool->mutex, NULL);
+	return pool;
+}
+
+static void free_list(struct ndi_pooled_frame *frame)
+{
+	while (frame) {
+		struct ndi_pooled_frame *next = frame->next;
+		free_frame(frame);
+		frame = next;
+	}
+}
+
+void ndi_frame_pool_destroy(struct ndi_frame_pool *pool)
+{
+	if (!pool)
+		return;
+
+	free_list(pool->free_frames);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool);
+}
+
+struct ndi_pooled_frame *
+ndi_frame_pool_get(struct ndi_frame_pool *pool,
+		   const struct ndi_frame_layout *layout)
+{
+	struct ndi_pooled_frame *stale = nullptr;
+	struct ndi_pooled_frame *frame = nullptr;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (!same_layout(&pool->layout, layout)) {
+		stale = pool->free_frames;
+		pool->free_frames = nullptr;
+		pool->layout = *layout;
+	}
+
+	frame = pool->free_frames;
+	if (frame)
+		pool->free_frames = frame->next;
+	pthread_mutex_unlock(&pool->mutex);
+
+	free_list(stale);
+
+	if (!frame) {
+		frame = alloc_frame(layout);
+		pool->allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	frame->next = nullptr;
+	return frame;
+}
+
+void ndi_frame_pool_put(struct ndi_frame_pool *pool,
+			struct ndi_pooled_frame *frame)
+{
+	if (!frame)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	const bool keep = same_layout(&pool->layout, &frame->layout);
+	if (keep) {
+		frame->next = pool->free_frames;
+		pool->free_frames = frame;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!keep)
+		free_frame(frame);
+}
+
+uint64_t ndi_frame_pool_get_allocations(const struct ndi_frame_pool *pool)
+{
+	return pool ? pool->allocations.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,67 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+// Reusable frame buffers for frames built on the receive threads
+// (conversions, deinterlacing...). Planes start on a cache line and their
+// rows are padded to one, so that SIMD kernels never straddle lines.
+//
+// A pool holds frames of one layout: asking for another layout frees the
+// cached frames, and frames of the old layout are freed when put back.
+// In steady state no memory is allocated.
+#define NDI_FRAME_POOL_MAX_PLANES 4
+#define NDI_FRAME_POOL_ALIGN 64
+
+struct ndi_frame_layout {
+	uint32_t plane_count;
+	uint32_t row_bytes[NDI_FRAME_POOL_MAX_PLANES];
+	uint32_t rows[NDI_FRAME_POOL_MAX_PLANES];
+};
+
+struct ndi_pooled_frame {
+	uint8_t *data[NDI_FRAME_POOL_MAX_PLANES];
+	uint32_t linesize[NDI_FRAME_POOL_MAX_PLANES];
+	struct ndi_frame_layout layout;
+
+	uint8_t *buffer;
+	struct ndi_pooled_frame *next;
+};
+
+// Plane layout libobs expects for 'format'. False for formats the pool
+// doesn't know.
+bool ndi_frame_layout_for_format(struct ndi_frame_layout *layout,
+				 enum video_format format, uint32_t width,
+				 uint32_t height);
+
+struct ndi_frame_pool *ndi_frame_pool_create();
+// Every frame must have been put back
+void ndi_frame_pool_destroy(struct ndi_frame_pool *pool);
+
+// Thread safe, frames can be put back from another thread than the one
+// that got them
+struct ndi_pooled_frame *
+ndi_frame_pool_get(struct ndi_frame_pool *pool,
+		   const struct ndi_frame_layout *layout);
+void ndi_frame_pool_put(struct ndi_frame_pool *pool,
+			struct ndi_pooled_frame *frame);
+
+// Frames allocated since the pool was created
+uint64_t ndi_frame_pool_get_allocations(const struct ndi_frame_pool *pool);
@@ -0,0 +1,164 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ndi-genlock.h"
+
+struct ndi_genlock_member {
+	void *param;
+	ndi_genlock_pull_cb pull;
+	int64_t timestamp;
+};
+
+struct ndi_genlock_group {
+	std::string name;
+	std::vector<ndi_genlock_member> members;
+	uint64_t frame_time;
+	uint32_t pulled;
+	int64_t reference;
+	int64_t spread;
+};
+
+// Few groups of few members: plain vectors, one lock for everything
+static pthread_mutex_t genlock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ndi_genlock_group *> genlock_groups;
+
+static ndi_genlock_group *find_group(void *param, size_t *index)
+{
+	for (ndi_genlock_group *g : genlock_groups) {
+		for (size_t i = 0; i < g->members.size(); ++i) {
+			if (g->members[i].param == param) {
+				*index = i;
+				return g;
+			}
+		}
+	}
+	return nullptr;
+}
+
+static void leave_locked(void *param)
+{
+	size_t index;
+	ndi_genlock_group *g = find_group(param, &index);
+	if (!g)
+		return;
+
+	g->members.erase(g->members.begin() + index);
+	if (!g->members.empty())
+		return;
+
+	blog(LOG_INFO, "genlock group '%s' removed", g->name.c_str());
+	for (size_t i = 0; i < genlock_groups.size(); ++i) {
+		if (genlock_groups[i] == g) {
+			genlock_groups.erase(genlock_groups.begin() + i);
+			break;
+		}
+	}
+	delete g;
+}
+
+void ndi_genlock_join(const char *name, void *param, ndi_genlock_pull_cb pull)
+{
+	pthread_mutex_lock(&genlock_mutex);
+	leave_locked(param);
+
+	if (name && *name) {
+		ndi_genlock_group *g = nullptr;
+		for (ndi_genlock_group *candidate : genlock_groups) {
+			if (candidate->name == name) {
+				g = candidate;
+				break;
+			}
+		}
+		if (!g) {
+			g = new ndi_genlock_group();
+			g->name = name;
+			genlock_groups.push_back(g);
+			blog(LOG_INFO, "genlock group '%s' created", name);
+		}
+		g->members.push_back({param, pull, -1});
+	}
+
+	pthread_mutex_unlock(&genlock_mutex);
+}
+
+void ndi_genlock_leave(void *param)
+{
+	pthread_mutex_lock(&genlock_mutex);
+	leave_locked(param);
+	pthread_mutex_unlock(&genlock_mutex);
+}
+
+// All members back to back, then the phase of their frames against the
+// first one that had a frame
+static void pull_group(ndi_genlock_group *g)
+{
+	for (ndi_genlock_member &m : g->members)
+		m.timestamp = m.pull(m.param);
+
+	g->pulled = 0;
+	g->reference = -1;
+	int64_t first = 0;
+	int64_t last = 0;
+	for (const ndi_genlock_member &m : g->members) {
+		if (m.timestamp < 0)
+			continue;
+		if (!g->pulled++) {
+			g->reference = m.timestamp;
+			first = last = m.timestamp;
+		}
+		first = std::min(first, m.timestamp);
+		last = std::max(last, m.timestamp);
+	}
+	g->spread = last - first;
+}
+
+bool ndi_genlock_tick(void *param, uint64_t frame_time)
+{
+	pthread_mutex_lock(&genlock_mutex);
+	size_t index;
+	ndi_genlock_group *g = find_group(param, &index);
+	if (g && g->frame_time != frame_time) {
+		g->frame_time = frame_time;
+		pull_group(g);
+	}
+	pthread_mutex_unlock(&genlock_mutex);
+	return g != nullptr;
+}
+
+bool ndi_genlock_get_phase(void *param, struct ndi_genlock_phase *phase)
+{
+	pthread_mutex_lock(&genlock_mutex);
+	size_t index;
+	ndi_genlock_group *g = find_group(param, &index);
+	const bool valid = g && g->members[index].timestamp >= 0 &&
+			   g->reference >= 0;
+	if (valid) {
+		phase->members = g->pulled;
+		phase->phase_error_ns =
+			g->members[index].timestamp - g->reference;
+		phase->spread_ns = g->spread;
+	}
+	pthread_mutex_unlock(&genlock_mutex);
+	return valid;
+}
@@ -0,0 +1,58 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Genlock groups of frame sync sources. Each source normally pulls its
+// frame sync from its own video_tick, so sources drawn in one OBS frame
+// sample their senders at slightly different times. The members of a
+// group are pulled together instead, by whichever member ticks first in
+// an OBS frame, and so all hold the frames their senders had at the same
+// instant.
+//
+// Members are keyed by an opaque pointer. The pull callback runs with the
+// group locked: it must not join or leave a group.
+
+// Pulls the member's video and returns the sender timestamp (ns) of the
+// frame it now shows, or a negative value when it has none
+typedef int64_t (*ndi_genlock_pull_cb)(void *param);
+
+// Moves 'param' to the group named 'name', leaving its previous group.
+// An empty or null name only leaves.
+void ndi_genlock_join(const char *name, void *param, ndi_genlock_pull_cb pull);
+void ndi_genlock_leave(void *param);
+
+// Called by every member on each tick. Pulls all members of the group of
+// 'param' once per 'frame_time' and returns true, or false when 'param'
+// isn't in a group and must pull on its own.
+bool ndi_genlock_tick(void *param, uint64_t frame_time);
+
+struct ndi_genlock_phase {
+	// Members with a frame in the last shared pull
+	uint32_t members;
+	// Timestamp of this member's frame minus the one of the first
+	// member that had a frame, in ns
+	int64_t phase_error_ns;
+	// Largest timestamp difference between two members
+	int64_t spread_ns;
+};
+
+// False when 'param' isn't in a group or had no frame at the last pull
+bool ndi_genlock_get_phase(void *param, struct ndi_genlock_phase *phase);
@@ -0,0 +1,823 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/task.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ndi-receiver-pool.h"
+
+struct ndi_receiver_subscriber {
+	void *param;
+	ndi_receiver_video_cb video_cb;
+	ndi_receiver_audio_cb audio_cb;
+};
+
+// Shortest capture timeout, used while frames are flowing and while not
+// connected. Connected idle receivers double it on every empty wait, up to
+// idle_timeout_ms.
+#define NDI_RECV_TIMEOUT_MIN_MS 100
+
+// Released receivers are torn down by this many reaper workers in
+// parallel, so that closing a scene collection doesn't wait on them one
+// after the other
+#define NDI_REAPER_WORKERS 8
+
+struct ndi_receiver_wait {
+	const char *kind;
+	uint32_t timeout_ms;
+	bool connected;
+	uint64_t connect_ts;
+	bool got_frame;
+};
+
+// Written by the metadata thread only. seq is odd while the slot is
+// being written and 2 * (index + 1) once frame 'index' is in it.
+struct ndi_metadata_slot {
+	std::atomic<uint64_t> seq;
+	int64_t timecode;
+	uint32_t size;
+	char data[NDI_METADATA_MAX_SIZE];
+};
+
+struct ndi_receiver_tally {
+	void *param;
+	bool on_preview;
+	bool on_program;
+};
+
+struct ndi_receiver {
+	std::string key;
+	std::string ndi_name;
+	long refs;
+	bool shared;
+	std::atomic<uint32_t> idle_timeout_ms;
+	std::atomic<uint32_t> max_video_queue;
+	std::atomic<uint64_t> stale_dropped;
+	// Written and read on the video thread only
+	uint64_t video_capture_ns;
+
+	// Creation parameters, used by the connect worker
+	NDIlib_recv_bandwidth_e bandwidth;
+	NDIlib_recv_color_format_e color_format;
+	bool hw_accel;
+	bool framesync;
+
+	// The instances are only read once state is CONNECTED. connect_done
+	// is signaled when the worker is done with the receiver. A receiver
+	// released before the worker got to it is never created.
+	std::atomic<ndi_receiver_state> state;
+	std::atomic<bool> cancelled;
+	os_event_t *connect_done;
+	NDIlib_recv_instance_t ndi_receiver;
+	NDIlib_framesync_instance_t ndi_framesync;
+
+	pthread_t video_thread;
+	pthread_t audio_thread;
+	pthread_t metadata_thread;
+	bool video_thread_started;
+	bool audio_thread_started;
+	bool metadata_thread_started;
+	std::atomic<bool> video_running;
+	std::atomic<bool> audio_running;
+	std::atomic<bool> metadata_running;
+	bool stopped;
+	os_performance_token_t *video_perf_token;
+	os_performance_token_t *audio_perf_token;
+
+	// The subscriber list is guarded by both mutexes: each capture
+	// thread only takes its own one, connect/disconnect take both.
+	pthread_mutex_t video_mutex;
+	pthread_mutex_t audio_mutex;
+	std::vector<ndi_receiver_subscriber> subscribers;
+
+	struct ndi_metadata_slot *metadata_ring;
+	std::atomic<uint64_t> metadata_count;
+	bool metadata_warned;
+
+	pthread_mutex_t placement_mutex;
+	struct ndi_thread_placement placement;
+	std::atomic<uint32_t> placement_gen;
+
+	pthread_mutex_t tally_mutex;
+	std::vector<ndi_receiver_tally> tallies;
+	NDIlib_tally_t tally;
+};
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, struct ndi_receiver *> pool;
+static os_task_queue_t *reaper_queues[NDI_REAPER_WORKERS];
+static size_t reaper_next;
+static os_task_queue_t *connect_queue;
+
+static std::string make_key(const struct ndi_receiver_desc *desc)
+{
+	std::string key = desc->ndi_name ? desc->ndi_name : "";
+	key += '\x1f';
+	key += std::to_string((int)desc->bandwidth);
+	key += '\x1f';
+	key += std::to_string((int)desc->color_format);
+	key += desc->hw_accel ? "\x1fhw" : "\x1fsw";
+	return key;
+}
+
+// Called by the capture threads at the top of their loop, 'placed' being
+// the generation they last applied
+static void ndi_receiver_place_thread(struct ndi_receiver *r,
+				      uint32_t *placed, const char *kind)
+{
+	const uint32_t gen = r->placement_gen;
+	if (*placed == gen)
+		return;
+	*placed = gen;
+
+	pthread_mutex_lock(&r->placement_mutex);
+	const struct ndi_thread_placement placement = r->placement;
+	pthread_mutex_unlock(&r->placement_mutex);
+
+	const std::string name = "NDI receiver '" + r->ndi_name + "' " + kind;
+	ndi_thread_place(NDI_THREAD_RECEIVE, &placement, name.c_str());
+}
+
+// recv_capture_v3 already returns as soon as a frame or a connection
+// change arrives, so the capture timeout is our wait primitive: no extra
+// polling of the connection count is needed. The timeout only bounds how
+// often an idle receiver wakes up, and grows while nothing comes in.
+//
+// It is also how long stopping can take: disconnecting the receiver
+// wakes connected captures, but nothing wakes a receiver waiting for its
+// sender. Those stay at the shortest timeout, so only connected receivers
+// back off.
+static void ndi_receiver_wait_update(struct ndi_receiver *r,
+				     struct ndi_receiver_wait *wait,
+				     NDIlib_frame_type_e frame_received,
+				     NDIlib_frame_type_e wanted)
+{
+	if (frame_received == wanted) {
+		wait->timeout_ms = NDI_RECV_TIMEOUT_MIN_MS;
+
+		if (!wait->got_frame) {
+			wait->got_frame = true;
+			if (wait->connect_ts) {
+				blog(LOG_INFO,
+				     "NDI receiver '%s': first %s frame %.1f ms "
+				     "after connect",
+				     r->ndi_name.c_str(), wait->kind,
+				     (double)(os_gettime_ns() -
+					      wait->connect_ts) /
+					     1000000.0);
+			}
+		}
+		return;
+	}
+
+	if (frame_received == NDIlib_frame_type_status_change ||
+	    frame_received == NDIlib_frame_type_error ||
+	    !wait->connected) {
+		const bool connected =
+			ndiLib->recv_get_no_connections(r->ndi_receiver) > 0;
+
+		if (connected && !wait->connected) {
+			wait->connect_ts = os_gettime_ns();
+			wait->got_frame = false;
+			wait->timeout_ms = NDI_RECV_TIMEOUT_MIN_MS;
+		} else if (!connected && wait->connected) {
+			blog(LOG_INFO, "NDI receiver '%s': %s disconnected",
+			     r->ndi_name.c_str(), wait->kind);
+		}
+		wait->connected = connected;
+	}
+
+	if (!wait->connected) {
+		wait->timeout_ms = NDI_RECV_TIMEOUT_MIN_MS;
+	} else if (frame_received == NDIlib_frame_type_none ||
+		   frame_received == NDIlib_frame_type_error) {
+		wait->timeout_ms = std::min(wait->timeout_ms * 2,
+					    r->idle_timeout_ms.load());
+		wait->timeout_ms =
+			std::max(wait->timeout_ms,
+				 (uint32_t)NDI_RECV_TIMEOUT_MIN_MS);
+	}
+}
+
+// Replaces 'frame' with the newest one when too many are queued behind it
+static void ndi_receiver_drop_stale(struct ndi_receiver *r,
+				    NDIlib_video_frame_v2_t *frame,
+				    uint32_t max_queue)
+{
+	NDIlib_recv_queue_t queue = {};
+	ndiLib->recv_get_queue(r->ndi_receiver, &queue);
+	if (queue.video_frames <= (int)max_queue)
+		return;
+
+	for (int i = 0; i < queue.video_frames; ++i) {
+		NDIlib_video_frame_v2_t newer;
+		if (ndiLib->recv_capture_v3(r->ndi_receiver, &newer, nullptr,
+					    nullptr, 0) !=
+		    NDIlib_frame_type_video)
+			break;
+
+		ndiLib->recv_free_video_v2(r->ndi_receiver, frame);
+		*frame = newer;
+		r->stale_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+static void *ndi_receiver_video_thread(void *data)
+{
+	auto r = (struct ndi_receiver *)data;
+
+	blog(LOG_INFO, "video thread for NDI receiver '%s' started",
+	     r->ndi_name.c_str());
+
+	NDIlib_video_frame_v2_t video_frame;
+
+	if (r->video_perf_token) {
+		os_end_high_performance(r->video_perf_token);
+	}
+	r->video_perf_token =
+		os_request_high_performance("NDI Receiver Video Thread");
+
+	struct ndi_receiver_wait wait = {"video", NDI_RECV_TIMEOUT_MIN_MS};
+
+	uint32_t placed = 0;
+	NDIlib_frame_type_e frame_received = NDIlib_frame_type_none;
+	while (r->video_running) {
+		ndi_receiver_place_thread(r, &placed, "video");
+		frame_received = ndiLib->recv_capture_v3(r->ndi_receiver,
+							 &video_frame, nullptr,
+							 nullptr,
+							 wait.timeout_ms);
+		ndi_receiver_wait_update(r, &wait, frame_received,
+					 NDIlib_frame_type_video);
+
+		if (frame_received != NDIlib_frame_type_video)
+			continue;
+
+		r->video_capture_ns = os_gettime_ns();
+		const uint32_t max_queue = r->max_video_queue;
+		if (max_queue)
+			ndi_receiver_drop_stale(r, &video_frame, max_queue);
+
+		pthread_mutex_lock(&r->video_mutex);
+		for (auto &sub : r->subscribers) {
+			if (sub.video_cb)
+				sub.video_cb(sub.param, r, &video_frame);
+		}
+		pthread_mutex_unlock(&r->video_mutex);
+
+		ndiLib->recv_free_video_v2(r->ndi_receiver, &video_frame);
+	}
+
+	os_end_high_performance(r->video_perf_token);
+	r->video_perf_token = NULL;
+
+	blog(LOG_INFO, "video thread for NDI receiver '%s' completed",
+	     r->ndi_name.c_str());
+	return nullptr;
+}
+
+static void *ndi_receiver_audio_thread(void *data)
+{
+	auto r = (struct ndi_receiver *)data;
+
+	blog(LOG_INFO, "audio thread for NDI receiver '%s' started",
+	     r->ndi_name.c_str());
+
+	NDIlib_audio_frame_v3_t audio_frame;
+
+	if (r->audio_perf_token) {
+		os_end_high_performance(r->audio_perf_token);
+	}
+	r->audio_perf_token =
+		os_request_high_performance("NDI Receiver Audio Thread");
+
+	struct ndi_receiver_wait wait = {"audio", NDI_RECV_TIMEOUT_MIN_MS};
+
+	uint32_t placed = 0;
+	NDIlib_frame_type_e frame_received = NDIlib_frame_type_none;
+	while (r->audio_running) {
+		ndi_receiver_place_thread(r, &placed, "audio");
+		frame_received = ndiLib->recv_capture_v3(r->ndi_receiver,
+							 nullptr, &audio_frame,
+							 nullptr,
+							 wait.timeout_ms);
+		ndi_receiver_wait_update(r, &wait, frame_received,
+					 NDIlib_frame_type_audio);
+
+		if (frame_received != NDIlib_frame_type_audio)
+			continue;
+
+		pthread_mutex_lock(&r->audio_mutex);
+		for (auto &sub : r->subscribers) {
+			if (sub.audio_cb)
+				sub.audio_cb(sub.param, r, &audio_frame);
+		}
+		pthread_mutex_unlock(&r->audio_mutex);
+
+		ndiLib->recv_free_audio_v3(r->ndi_receiver, &audio_frame);
+	}
+
+	os_end_high_performance(r->audio_perf_token);
+	r->audio_perf_token = NULL;
+
+	blog(LOG_INFO, "audio thread for NDI receiver '%s' completed",
+	     r->ndi_name.c_str());
+	return nullptr;
+}
+
+static void ndi_receiver_push_metadata(struct ndi_receiver *r,
+				       const NDIlib_metadata_frame_t *frame)
+{
+	const size_t size = frame->p_data ? strlen(frame->p_data) : 0;
+	if (size >= NDI_METADATA_MAX_SIZE) {
+		if (!r->metadata_warned) {
+			blog(LOG_WARNING,
+			     "NDI receiver '%s': dropping metadata frames "
+			     "larger than %d bytes",
+			     r->ndi_name.c_str(), NDI_METADATA_MAX_SIZE);
+			r->metadata_warned = true;
+		}
+		return;
+	}
+
+	const uint64_t index =
+		r->metadata_count.load(std::memory_order_relaxed);
+	struct ndi_metadata_slot *slot =
+		&r->metadata_ring[index % NDI_METADATA_RING_SIZE];
+
+	slot->seq.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot->timecode = frame->timecode;
+	slot->size = (uint32_t)size;
+	memcpy(slot->data, frame->p_data, size);
+	slot->data[size] = 0;
+
+	slot->seq.store(index * 2 + 2, std::memory_order_release);
+	r->metadata_count.store(index + 1, std::memory_order_release);
+}
+
+// Metadata gets its own capture thread, so that video and audio never
+// wait on it, nor on whoever reads it. It doesn't back off: most senders
+// send no metadata at all, and the timeout bounds how long stopping takes.
+static void *ndi_receiver_metadata_thread(void *data)
+{
+	auto r = (struct ndi_receiver *)data;
+
+	uint32_t placed = 0;
+	NDIlib_metadata_frame_t metadata_frame;
+	while (r->metadata_running) {
+		ndi_receiver_place_thread(r, &placed, "metadata");
+		if (ndiLib->recv_capture_v3(r->ndi_receiver, nullptr, nullptr,
+					    &metadata_frame,
+					    NDI_RECV_TIMEOUT_MIN_MS) !=
+		    NDIlib_frame_type_metadata)
+			continue;
+
+		ndi_receiver_push_metadata(r, &metadata_frame);
+		ndiLib->recv_free_metadata(r->ndi_receiver, &metadata_frame);
+	}
+
+	return nullptr;
+}
+
+// Runs on the connect worker, so that neither OBS startup nor the
+// settings dialog wait on the NDI runtime
+static void ndi_receiver_connect_task(void *param)
+{
+	auto r = (struct ndi_receiver *)param;
+
+	if (r->cancelled) {
+		r->state = NDI_RECEIVER_FAILED;
+		os_event_signal(r->connect_done);
+		return;
+	}
+
+	NDIlib_recv_create_v3_t recv_desc;
+	recv_desc.source_to_connect_to.p_ndi_name = r->ndi_name.c_str();
+	recv_desc.allow_video_fields = true;
+	recv_desc.color_format = r->color_format;
+	recv_desc.bandwidth = r->bandwidth;
+	recv_desc.p_ndi_recv_name = nullptr;
+
+	const uint64_t start = os_gettime_ns();
+	NDIlib_recv_instance_t instance = ndiLib->recv_create_v3(&recv_desc);
+	if (!instance) {
+		blog(LOG_ERROR, "can't create NDI receiver for '%s'",
+		     r->ndi_name.c_str());
+
+		// Later acquires get a new attempt instead of this receiver
+		pthread_mutex_lock(&pool_mutex);
+		if (r->shared)
+			pool.erase(r->key);
+		r->shared = false;
+		pthread_mutex_unlock(&pool_mutex);
+
+		r->state = NDI_RECEIVER_FAILED;
+		os_event_signal(r->connect_done);
+		return;
+	}
+
+	if (r->hw_accel) {
+		NDIlib_metadata_frame_t hwAccelMetadata;
+		hwAccelMetadata.p_data =
+			(char *)"<ndi_hwaccel enabled=\"true\"/>";
+		ndiLib->recv_send_metadata(instance, &hwAccelMetadata);
+	}
+
+	// Tally set while connecting is applied along with the instance
+	pthread_mutex_lock(&r->tally_mutex);
+	r->ndi_receiver = instance;
+	if (r->tally.on_preview || r->tally.on_program)
+		ndiLib->recv_set_tally(instance, &r->tally);
+	pthread_mutex_unlock(&r->tally_mutex);
+
+	r->metadata_running = true;
+	r->metadata_thread_started =
+		pthread_create(&r->metadata_thread, nullptr,
+			       ndi_receiver_metadata_thread, r) == 0;
+
+	if (r->framesync) {
+		r->ndi_framesync = ndiLib->framesync_create(instance);
+	} else {
+		if (r->bandwidth != NDIlib_recv_bandwidth_audio_only) {
+			r->video_running = true;
+			r->video_thread_started =
+				pthread_create(&r->video_thread, nullptr,
+					       ndi_receiver_video_thread,
+					       r) == 0;
+		}
+
+		r->audio_running = true;
+		r->audio_thread_started =
+			pthread_create(&r->audio_thread, nullptr,
+				       ndi_receiver_audio_thread, r) == 0;
+	}
+
+	blog(LOG_INFO, "connected NDI receiver for '%s' in %.1f ms",
+	     r->ndi_name.c_str(), (double)(os_gettime_ns() - start) / 1000000.0);
+
+	r->state = NDI_RECEIVER_CONNECTED;
+	os_event_signal(r->connect_done);
+}
+
+// Called with pool_mutex held
+static struct ndi_receiver *
+ndi_receiver_create(const struct ndi_receiver_desc *desc)
+{
+	auto r = new struct ndi_receiver();
+	r->ndi_name = desc->ndi_name ? desc->ndi_name : "";
+	r->refs = 1;
+	r->shared = !desc->framesync;
+	r->idle_timeout_ms = std::max(desc->idle_timeout_ms,
+				      (uint32_t)NDI_RECV_TIMEOUT_MIN_MS);
+	r->bandwidth = desc->bandwidth;
+	r->color_format = desc->color_format;
+	r->hw_accel = desc->hw_accel;
+	r->framesync = desc->framesync;
+	r->state = NDI_RECEIVER_CONNECTING;
+	r->placement = desc->placement;
+	r->max_video_queue = desc->max_video_queue;
+	r->placement_gen = 1;
+	r->metadata_ring =
+		new struct ndi_metadata_slot[NDI_METADATA_RING_SIZE]();
+	os_event_init(&r->connect_done, OS_EVENT_TYPE_MANUAL);
+	pthread_mutex_init(&r->video_mutex, NULL);
+	pthread_mutex_init(&r->audio_mutex, NULL);
+	pthread_mutex_init(&r->tally_mutex, NULL);
+	pthread_mutex_init(&r->placement_mutex, NULL);
+
+	if (!connect_queue)
+		connect_queue = os_task_queue_create();
+	os_task_queue_queue_task(connect_queue, ndi_receiver_connect_task, r);
+	return r;
+}
+
+// Asks the capture threads to stop. Dropping the connection wakes the
+// ones waiting on a connected source with a status change, the others
+// wait at most NDI_RECV_TIMEOUT_MIN_MS (see ndi_receiver_wait_update).
+static void ndi_receiver_stop(struct ndi_receiver *r)
+{
+	if (r->stopped)
+		return;
+	r->stopped = true;
+
+	r->video_running = false;
+	r->audio_running = false;
+	r->metadata_running = false;
+	if (r->ndi_receiver)
+		ndiLib->recv_connect(r->ndi_receiver, nullptr);
+}
+
+static void ndi_receiver_destroy(struct ndi_receiver *r)
+{
+	// A receiver released while connecting is torn down right after
+	os_event_wait(r->connect_done);
+	os_event_destroy(r->connect_done);
+
+	ndi_receiver_stop(r);
+
+	// The flags were cleared by stop, the thread handles tell which
+	// threads were started
+	if (r->video_thread_started)
+		pthread_join(r->video_thread, NULL);
+	if (r->audio_thread_started)
+		pthread_join(r->audio_thread, NULL);
+	if (r->metadata_thread_started)
+		pthread_join(r->metadata_thread, NULL);
+
+	if (r->ndi_framesync)
+		ndiLib->framesync_destroy(r->ndi_framesync);
+	if (r->ndi_receiver)
+		ndiLib->recv_destroy(r->ndi_receiver);
+
+	pthread_mutex_destroy(&r->video_mutex);
+	pthread_mutex_destroy(&r->audio_mutex);
+	pthread_mutex_destroy(&r->tally_mutex);
+	pthread_mutex_destroy(&r->placement_mutex);
+	delete[] r->metadata_ring;
+
+	blog(LOG_INFO, "destroyed NDI receiver for '%s'", r->ndi_name.c_str());
+	delete r;
+}
+
+static void ndi_receiver_destroy_task(void *param)
+{
+	ndi_receiver_destroy((struct ndi_receiver *)param);
+}
+
+// For the last reference, once the receiver is out of the pool
+static void ndi_receiver_reap(struct ndi_receiver *r)
+{
+	// Connected receivers start stopping right away, so that the waits
+	// of every receiver released in a row overlap. Others are cancelled
+	// and stopped by the reaper once the connect worker is done.
+	if (r->state == NDI_RECEIVER_CONNECTED)
+		ndi_receiver_stop(r);
+	else
+		r->cancelled = true;
+
+	pthread_mutex_lock(&pool_mutex);
+	os_task_queue_t **queue = &reaper_queues[reaper_next];
+	reaper_next = (reaper_next + 1) % NDI_REAPER_WORKERS;
+	if (!*queue)
+		*queue = os_task_queue_create();
+	os_task_queue_queue_task(*queue, ndi_receiver_destroy_task, r);
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+struct ndi_receiver *ndi_receiver_acquire(const struct ndi_receiver_desc *desc)
+{
+	struct ndi_receiver *r = nullptr;
+	const std::string key = make_key(desc);
+
+	pthread_mutex_lock(&pool_mutex);
+
+	if (!desc->framesync) {
+		auto it = pool.find(key);
+		if (it != pool.end()) {
+			r = it->second;
+			r->refs++;
+
+			// Shared receivers back off as little as their most
+			// demanding subscriber asks for
+			if (desc->idle_timeout_ms >= NDI_RECV_TIMEOUT_MIN_MS &&
+			    desc->idle_timeout_ms < r->idle_timeout_ms)
+				r->idle_timeout_ms = desc->idle_timeout_ms;
+			blog(LOG_INFO,
+			     "NDI receiver for '%s' is now shared by %ld sources",
+			     r->ndi_name.c_str(), r->refs);
+		}
+	}
+
+	if (!r) {
+		r = ndi_receiver_create(desc);
+		r->key = key;
+		if (r->shared)
+			pool[key] = r;
+		blog(LOG_INFO, "connecting NDI receiver for '%s'",
+		     r->ndi_name.c_str());
+	}
+
+	pthread_mutex_unlock(&pool_mutex);
+	return r;
+}
+
+void ndi_receiver_release(struct ndi_receiver *r)
+{
+	if (!r)
+		return;
+
+	pthread_mutex_lock(&pool_mutex);
+	const bool last = (--r->refs == 0);
+	if (last && r->shared)
+		pool.erase(r->key);
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (last)
+		ndi_receiver_reap(r);
+}
+
+void ndi_receiver_pool_shutdown()
+{
+	const uint64_t start = os_gettime_ns();
+
+	pthread_mutex_lock(&pool_mutex);
+	os_task_queue_t *queues[NDI_REAPER_WORKERS];
+	for (size_t i = 0; i < NDI_REAPER_WORKERS; ++i) {
+		queues[i] = reaper_queues[i];
+		reaper_queues[i] = nullptr;
+	}
+	pthread_mutex_unlock(&pool_mutex);
+
+	// Each worker finishes its queued teardowns before returning. They
+	// may wait on connections, so the connect worker goes last.
+	for (size_t i = 0; i < NDI_REAPER_WORKERS; ++i) {
+		if (queues[i])
+			os_task_queue_destroy(queues[i]);
+	}
+
+	pthread_mutex_lock(&pool_mutex);
+	os_task_queue_t *queue = connect_queue;
+	connect_queue = nullptr;
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (queue)
+		os_task_queue_destroy(queue);
+
+	blog(LOG_INFO, "NDI receivers torn down in %.1f ms",
+	     (double)(os_gettime_ns() - start) / 1000000.0);
+}
+
+enum ndi_receiver_state ndi_receiver_get_state(const struct ndi_receiver *r)
+{
+	return r ? r->state.load() : NDI_RECEIVER_FAILED;
+}
+
+void ndi_receiver_connect(struct ndi_receiver *r, void *param,
+			  ndi_receiver_video_cb video_cb,
+			  ndi_receiver_audio_cb audio_cb)
+{
+	pthread_mutex_lock(&r->video_mutex);
+	pthread_mutex_lock(&r->audio_mutex);
+	r->subscribers.push_back({param, video_cb, audio_cb});
+	pthread_mutex_unlock(&r->audio_mutex);
+	pthread_mutex_unlock(&r->video_mutex);
+}
+
+static void ndi_receiver_update_tally(struct ndi_receiver *r)
+{
+	NDIlib_tally_t tally;
+	tally.on_preview = false;
+	tally.on_program = false;
+	for (auto &t : r->tallies) {
+		tally.on_preview |= t.on_preview;
+		tally.on_program |= t.on_program;
+	}
+
+	if (tally.on_preview != r->tally.on_preview ||
+	    tally.on_program != r->tally.on_program) {
+		r->tally = tally;
+		if (r->ndi_receiver)
+			ndiLib->recv_set_tally(r->ndi_receiver, &r->tally);
+	}
+}
+
+void ndi_receiver_disconnect(struct ndi_receiver *r, void *param)
+{
+	pthread_mutex_lock(&r->video_mutex);
+	pthread_mutex_lock(&r->audio_mutex);
+	for (auto it = r->subscribers.begin(); it != r->subscribers.end();
+	     ++it) {
+		if (it->param == param) {
+			r->subscribers.erase(it);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&r->audio_mutex);
+	pthread_mutex_unlock(&r->video_mutex);
+
+	pthread_mutex_lock(&r->tally_mutex);
+	for (auto it = r->tallies.begin(); it != r->tallies.end(); ++it) {
+		if (it->param == param) {
+			r->tallies.erase(it);
+			break;
+		}
+	}
+	ndi_receiver_update_tally(r);
+	pthread_mutex_unlock(&r->tally_mutex);
+}
+
+void ndi_receiver_set_placement(struct ndi_receiver *r,
+				const struct ndi_thread_placement *placement)
+{
+	pthread_mutex_lock(&r->placement_mutex);
+	const bool changed = r->placement.cpus != placement->cpus ||
+			     r->placement.priority != placement->priority;
+	r->placement = *placement;
+	pthread_mutex_unlock(&r->placement_mutex);
+
+	if (changed)
+		r->placement_gen++;
+}
+
+void ndi_receiver_set_max_video_queue(struct ndi_receiver *r, uint32_t frames)
+{
+	r->max_video_queue = frames;
+}
+
+uint64_t ndi_receiver_get_stale_dropped(const struct ndi_receiver *r)
+{
+	return r ? r->stale_dropped.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t ndi_receiver_get_capture_time(const struct ndi_receiver *r)
+{
+	return r->video_capture_ns;
+}
+
+void ndi_receiver_set_tally(struct ndi_receiver *r, void *param,
+			    bool on_preview, bool on_program)
+{
+	pthread_mutex_lock(&r->tally_mutex);
+
+	bool found = false;
+	for (auto &t : r->tallies) {
+		if (t.param == param) {
+			t.on_preview = on_preview;
+			t.on_program = on_program;
+			found = true;
+			break;
+		}
+	}
+	if (!found)
+		r->tallies.push_back({param, on_preview, on_program});
+
+	ndi_receiver_update_tally(r);
+	pthread_mutex_unlock(&r->tally_mutex);
+}
+
+uint64_t ndi_receiver_metadata_count(const struct ndi_receiver *r)
+{
+	return r ? r->metadata_count.load(std::memory_order_acquire) : 0;
+}
+
+bool ndi_receiver_read_metadata(const struct ndi_receiver *r, uint64_t index,
+				struct ndi_metadata_frame *frame)
+{
+	if (index >= ndi_receiver_metadata_count(r))
+		return false;
+
+	const struct ndi_metadata_slot *slot =
+		&r->metadata_ring[index % NDI_METADATA_RING_SIZE];
+	const uint64_t seq = index * 2 + 2;
+	if (slot->seq.load(std::memory_order_acquire) != seq)
+		return false;
+
+	frame->timecode = slot->timecode;
+	frame->size = std::min(slot->size, (uint32_t)NDI_METADATA_MAX_SIZE - 1);
+	memcpy(frame->data, slot->data, frame->size);
+	frame->data[frame->size] = 0;
+
+	// The writer moved on to a newer frame while we were copying
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+NDIlib_recv_instance_t ndi_receiver_get_instance(const struct ndi_receiver *r)
+{
+	return ndi_receiver_get_state(r) == NDI_RECEIVER_CONNECTED
+		       ? r->ndi_receiver
+		       : nullptr;
+}
+
+NDIlib_framesync_instance_t
+ndi_receiver_get_framesync(const struct ndi_receiver *r)
+{
+	return ndi_receiver_get_state(r) == NDI_RECEIVER_CONNECTED
+		       ? r->ndi_framesync
+		       : nullptr;
+}
@@ -0,0 +1,126 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "obs-ndi.h"
+#include "ndi-thread-placement.h"
+
+// Process-wide pool of NDI receivers. Sources asking for the same NDI
+// name, bandwidth and color format share one receiver: it is decoded
+// once and every frame is handed to all connected subscribers from the
+// receiver's capture threads.
+struct ndi_receiver;
+
+// Receivers are created on a background worker: acquire returns at once
+// with a connecting receiver. Subscribers and tally can be set right
+// away, frames flow once it's connected.
+enum ndi_receiver_state {
+	NDI_RECEIVER_CONNECTING,
+	NDI_RECEIVER_CONNECTED,
+	NDI_RECEIVER_FAILED,
+};
+
+typedef void (*ndi_receiver_video_cb)(void *param, struct ndi_receiver *r,
+				      const NDIlib_video_frame_v2_t *frame);
+typedef void (*ndi_receiver_audio_cb)(void *param, struct ndi_receiver *r,
+				      const NDIlib_audio_frame_v3_t *frame);
+
+struct ndi_receiver_desc {
+	const char *ndi_name;
+	NDIlib_recv_bandwidth_e bandwidth;
+	NDIlib_recv_color_format_e color_format;
+	bool hw_accel;
+
+	// Longest capture wait of an idle receiver, in milliseconds
+	uint32_t idle_timeout_ms;
+
+	// Of the capture threads, see ndi_receiver_set_placement
+	struct ndi_thread_placement placement;
+
+	// See ndi_receiver_set_max_video_queue
+	uint32_t max_video_queue;
+
+	// Frame sync receivers are never shared: pulling audio from one
+	// frame sync on behalf of several sources would split the samples.
+	// No capture threads are started for them.
+	bool framesync;
+};
+
+// Releasing never blocks: the last release stops the capture threads
+// and hands the receiver to a pool of reaper threads, which tear several
+// receivers down in parallel.
+struct ndi_receiver *ndi_receiver_acquire(const struct ndi_receiver_desc *desc);
+void ndi_receiver_release(struct ndi_receiver *r);
+
+// Waits for pending creations and teardowns, on module unload
+void ndi_receiver_pool_shutdown();
+
+enum ndi_receiver_state ndi_receiver_get_state(const struct ndi_receiver *r);
+
+// Callbacks run on the receiver's capture threads. Once disconnect
+// returns, no callback for that param is running or will run again.
+void ndi_receiver_connect(struct ndi_receiver *r, void *param,
+			  ndi_receiver_video_cb video_cb,
+			  ndi_receiver_audio_cb audio_cb);
+void ndi_receiver_disconnect(struct ndi_receiver *r, void *param);
+
+// Moves the capture threads, they pick the change up on their next wait.
+// A shared receiver follows the last subscriber that set one.
+void ndi_receiver_set_placement(struct ndi_receiver *r,
+				const struct ndi_thread_placement *placement);
+
+// Bounds the latency of video: when more than 'frames' frames wait in the
+// SDK queue, it is drained and only the newest frame is delivered. Audio
+// is never dropped. 0 delivers every frame. Last caller wins.
+void ndi_receiver_set_max_video_queue(struct ndi_receiver *r, uint32_t frames);
+// Video frames dropped that way so far. A shared receiver drops frames
+// for all its subscribers at once: this is a total of the receiver.
+uint64_t ndi_receiver_get_stale_dropped(const struct ndi_receiver *r);
+
+// From a video callback: when the frame being delivered was returned by
+// the SDK, in os_gettime_ns time
+uint64_t ndi_receiver_get_capture_time(const struct ndi_receiver *r);
+
+// The receiver advertises the union of its subscribers' tally states
+void ndi_receiver_set_tally(struct ndi_receiver *r, void *param,
+			    bool on_preview, bool on_program);
+
+// Metadata frames sent by the NDI source, numbered from 0 in arrival
+// order. A receiver keeps the last NDI_METADATA_RING_SIZE of them in a
+// lock-free ring: readers copy a frame out, and a frame overwritten while
+// being read is reported as missing. Frames larger than
+// NDI_METADATA_MAX_SIZE (including the terminating null) are dropped.
+#define NDI_METADATA_RING_SIZE 32
+#define NDI_METADATA_MAX_SIZE 8192
+
+struct ndi_metadata_frame {
+	int64_t timecode;
+	uint32_t size;
+	char data[NDI_METADATA_MAX_SIZE];
+};
+
+// Number of metadata frames received so far
+uint64_t ndi_receiver_metadata_count(const struct ndi_receiver *r);
+bool ndi_receiver_read_metadata(const struct ndi_receiver *r, uint64_t index,
+				struct ndi_metadata_frame *frame);
+
+// Both are null until the receiver is connected
+NDIlib_recv_instance_t ndi_receiver_get_instance(const struct ndi_receiver *r);
+NDIlib_framesync_instance_t
+ndi_receiver_get_framesync(const struct ndi_receiver *r);
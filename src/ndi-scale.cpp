@@ -0,0 +1,262 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+
+#include "ndi-scale.h"
+#include "ndi-convert.h"
+#include "ndi-frame-pool.h"
+
+// One pool per level: in steady state every level gets frames of the
+// same layout and nothing is allocated
+struct ndi_scaler {
+	struct ndi_frame_pool *pools[NDI_SCALER_MAX_LEVELS];
+	struct ndi_pooled_frame *frames[NDI_SCALER_MAX_LEVELS];
+};
+
+struct ndi_scaler *ndi_scaler_create()
+{
+	auto sc = (struct ndi_scaler *)bzalloc(sizeof(struct ndi_scaler));
+	for (size_t i = 0; i < NDI_SCALER_MAX_LEVELS; ++i)
+		sc->pools[i] = ndi_frame_pool_create();
+	return sc;
+}
+
+void ndi_scaler_destroy(struct ndi_scaler *sc)
+{
+	if (!sc)
+		return;
+
+	ndi_scaler_release(sc);
+	for (size_t i = 0; i < NDI_SCALER_MAX_LEVELS; ++i)
+		ndi_frame_pool_destroy(sc->pools[i]);
+	bfree(sc);
+}
+
+void ndi_scaler_release(struct ndi_scaler *sc)
+{
+	for (size_t i = 0; i < NDI_SCALER_MAX_LEVELS; ++i) {
+		ndi_frame_pool_put(sc->pools[i], sc->frames[i]);
+		sc->frames[i] = nullptr;
+	}
+}
+
+static bool can_halve(const struct obs_source_frame *frame)
+{
+	switch (frame->format) {
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+		return frame->width >= 4 && frame->height >= 4 &&
+		       frame->width % 4 == 0 && frame->height % 4 == 0;
+	default:
+		return false;
+	}
+}
+
+static void halve_plane(const struct obs_source_frame *in,
+			const struct ndi_pooled_frame *out, size_t plane,
+			uint32_t unit, uint32_t count, uint32_t rows)
+{
+	const uint8_t *src = in->data[plane];
+	const uint32_t src_linesize = in->linesize[plane];
+	uint8_t *dst = out->data[plane];
+
+	for (uint32_t y = 0; y < rows; ++y) {
+		const uint8_t *row0 = src + (size_t)y * 2 * src_linesize;
+		uint8_t *dst_row = dst + (size_t)y * out->linesize[plane];
+		if (unit)
+			ndi_convert_halve_rows(row0, row0 + src_linesize,
+					       dst_row, unit, count);
+		else
+			ndi_convert_halve_uyvy_rows(row0, row0 + src_linesize,
+						    dst_row, count);
+	}
+}
+
+static void halve_frame(const struct obs_source_frame *in,
+			const struct ndi_pooled_frame *out)
+{
+	const uint32_t cx = in->width / 2;
+	const uint32_t cy = in->height / 2;
+
+	switch (in->format) {
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_RGBA:
+		halve_plane(in, out, 0, 4, cx, cy);
+		break;
+
+	case VIDEO_FORMAT_UYVY:
+		// Unit 0: packed pixel pairs
+		halve_plane(in, out, 0, 0, cx / 2, cy);
+		break;
+
+	case VIDEO_FORMAT_I420:
+		halve_plane(in, out, 0, 1, cx, cy);
+		halve_plane(in, out, 1, 1, cx / 2, cy / 2);
+		halve_plane(in, out, 2, 1, cx / 2, cy / 2);
+		break;
+
+	case VIDEO_FORMAT_NV12:
+		halve_plane(in, out, 0, 1, cx, cy);
+		halve_plane(in, out, 1, 2, cx / 2, cy / 2);
+		break;
+
+	default:
+		break;
+	}
+}
+
+struct crop_plane {
+	uint32_t x_shift;
+	uint32_t y_shift;
+	uint32_t unit_bytes;
+};
+
+static size_t get_crop_planes(enum video_format format, crop_plane *planes)
+{
+	switch (format) {
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_RGBA:
+		planes[0] = {0, 0, 4};
+		return 1;
+
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_YUY2:
+		// 4 bytes per pixel pair
+		planes[0] = {1, 0, 4};
+		return 1;
+
+	case VIDEO_FORMAT_I420:
+		planes[0] = {0, 0, 1};
+		planes[1] = planes[2] = {1, 1, 1};
+		return 3;
+
+	case VIDEO_FORMAT_NV12:
+		planes[0] = {0, 0, 1};
+		planes[1] = {1, 1, 2};
+		return 2;
+
+	case VIDEO_FORMAT_I422:
+		planes[0] = {0, 0, 1};
+		planes[1] = planes[2] = {1, 0, 1};
+		return 3;
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(26, 1, 0)
+	case VIDEO_FORMAT_I42A:
+		planes[0] = planes[3] = {0, 0, 1};
+		planes[1] = planes[2] = {1, 0, 1};
+		return 4;
+#endif
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+	case VIDEO_FORMAT_P010:
+		planes[0] = {0, 0, 2};
+		planes[1] = {1, 1, 4};
+		return 2;
+#endif
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(29, 1, 0)
+	case VIDEO_FORMAT_P216:
+		planes[0] = {0, 0, 2};
+		planes[1] = {1, 0, 4};
+		return 2;
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+bool ndi_frame_crop(struct obs_source_frame *frame, uint32_t left,
+		    uint32_t top, uint32_t right, uint32_t bottom)
+{
+	if (!left && !top && !right && !bottom)
+		return false;
+
+	crop_plane planes[MAX_AV_PLANES];
+	const size_t count = get_crop_planes(frame->format, planes);
+	if (!count)
+		return false;
+
+	uint32_t x_shift = 0;
+	uint32_t y_shift = 0;
+	for (size_t i = 0; i < count; ++i) {
+		x_shift = std::max(x_shift, planes[i].x_shift);
+		y_shift = std::max(y_shift, planes[i].y_shift);
+	}
+
+	// Whole chroma samples only
+	left = (left >> x_shift) << x_shift;
+	right = (right >> x_shift) << x_shift;
+	top = (top >> y_shift) << y_shift;
+	bottom = (bottom >> y_shift) << y_shift;
+
+	if ((uint64_t)left + right >= frame->width ||
+	    (uint64_t)top + bottom >= frame->height)
+		return false;
+
+	for (size_t i = 0; i < count; ++i) {
+		const size_t row = top >> planes[i].y_shift;
+		const size_t unit = left >> planes[i].x_shift;
+		frame->data[i] += row * frame->linesize[i] +
+				  unit * planes[i].unit_bytes;
+	}
+	frame->width -= left + right;
+	frame->height -= top + bottom;
+	return true;
+}
+
+bool ndi_scaler_shrink(struct ndi_scaler *sc, struct obs_source_frame *frame,
+		       uint32_t target_width, uint32_t target_height)
+{
+	ndi_scaler_release(sc);
+	if (!target_width && !target_height)
+		return false;
+
+	size_t level = 0;
+	while (level < NDI_SCALER_MAX_LEVELS && can_halve(frame) &&
+	       frame->width / 2 >= target_width &&
+	       frame->height / 2 >= target_height) {
+		const uint32_t cx = frame->width / 2;
+		const uint32_t cy = frame->height / 2;
+
+		struct ndi_frame_layout layout;
+		ndi_frame_layout_for_format(&layout, frame->format, cx, cy);
+		struct ndi_pooled_frame *out =
+			ndi_frame_pool_get(sc->pools[level], &layout);
+		sc->frames[level++] = out;
+
+		halve_frame(frame, out);
+
+		for (size_t i = 0; i < MAX_AV_PLANES; ++i) {
+			const bool used = i < layout.plane_count;
+			frame->data[i] = used ? out->data[i] : nullptr;
+			frame->linesize[i] = used ? out->linesize[i] : 0;
+		}
+		frame->width = cx;
+		frame->height = cy;
+	}
+
+	return level > 0;
+}
@@ -0,0 +1,52 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+// Receive-side geometry of frames, applied before libobs copies and
+// uploads them.
+
+// Crops 'frame' in place by moving its plane pointers and reducing its
+// size: no pixel is copied. Crop amounts are rounded down to the chroma
+// subsampling of the format, which can keep one more row or column per
+// edge. Returns false, leaving the frame untouched, for unknown formats
+// or when nothing would be left.
+bool ndi_frame_crop(struct obs_source_frame *frame, uint32_t left,
+		    uint32_t top, uint32_t right, uint32_t bottom);
+
+// Downscaling of large frames shown small. Frames are halved
+// with a 2x2 box filter, as many times as they stay at least as large as
+// the target, before libobs copies and uploads them.
+//
+// BGRA, BGRX, RGBA, UYVY, I420 and NV12 frames are handled. A frame is
+// only halved while both its dimensions are multiples of 4, so that the
+// chroma planes halve exactly.
+#define NDI_SCALER_MAX_LEVELS 3
+
+struct ndi_scaler *ndi_scaler_create();
+void ndi_scaler_destroy(struct ndi_scaler *sc);
+
+// Shrinks 'frame' in place towards 'target_width' x 'target_height'. A
+// target of 0 doesn't constrain that dimension, both 0 disable scaling.
+// Returns false when the frame was left untouched. The new planes belong
+// to the scaler and stay valid until the next call or release.
+bool ndi_scaler_shrink(struct ndi_scaler *sc, struct obs_source_frame *frame,
+		       uint32_t target_width, uint32_t target_height);
+void ndi_scaler_release(struct ndi_scaler *sc);
@@ -0,0 +1,229 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <errno.h>
+#include <chrono>
+#include <vector>
+
+#include "ndi-stats.h"
+
+#define STATS_FILE_INTERVAL_MS 5000
+#define STATS_LOG_EVERY 12
+
+struct ndi_stats_source {
+	void *param;
+	ndi_stats_snapshot_cb cb;
+};
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ndi_stats_source> stats_sources;
+static pthread_t stats_thread;
+static os_event_t *stats_stop_event;
+static bool stats_running;
+
+void ndi_stats_add_latency(struct ndi_stats_counters *c, uint64_t ns)
+{
+	ndi_stats_add(c->latency_total, ns);
+	ndi_stats_add(c->latency_count);
+	ndi_stats_add_max(c->latency_max, ns);
+}
+
+void ndi_stats_add_convert(struct ndi_stats_counters *c, uint64_t ns)
+{
+	ndi_stats_add(c->convert_total, ns);
+	ndi_stats_add(c->convert_count);
+	ndi_stats_add_max(c->convert_max, ns);
+}
+
+static double average_ms(const std::atomic<uint64_t> &total,
+			 const std::atomic<uint64_t> &count)
+{
+	const uint64_t n = count.load(std::memory_order_relaxed);
+	if (!n)
+		return 0.0;
+	return (double)total.load(std::memory_order_relaxed) / (double)n /
+	       1000000.0;
+}
+
+void ndi_stats_fill(obs_data_t *data, const struct ndi_stats_counters *c,
+		    NDIlib_recv_instance_t recv)
+{
+	obs_data_set_int(data, "video_frames", (long long)c->video_frames);
+	obs_data_set_int(data, "audio_frames", (long long)c->audio_frames);
+	obs_data_set_int(data, "video_discarded",
+			 (long long)c->video_discarded);
+
+	obs_data_set_double(data, "latency_avg_ms",
+			    average_ms(c->latency_total, c->latency_count));
+	obs_data_set_double(data, "latency_max_ms",
+			    (double)c->latency_max / 1000000.0);
+	obs_data_set_double(data, "convert_avg_ms",
+			    average_ms(c->convert_total, c->convert_count));
+	obs_data_set_double(data, "convert_max_ms",
+			    (double)c->convert_max / 1000000.0);
+
+	if (!recv)
+		return;
+
+	NDIlib_recv_performance_t total = {};
+	NDIlib_recv_performance_t dropped = {};
+	ndiLib->recv_get_performance(recv, &total, &dropped);
+
+	NDIlib_recv_queue_t queue = {};
+	ndiLib->recv_get_queue(recv, &queue);
+
+	// Receivers can be shared: these are totals of the receiver, not of
+	// this source
+	obs_data_set_int(data, "sdk_video_frames", total.video_frames);
+	obs_data_set_int(data, "sdk_video_dropped", dropped.video_frames);
+	obs_data_set_int(data, "sdk_audio_frames", total.audio_frames);
+	obs_data_set_int(data, "sdk_audio_dropped", dropped.audio_frames);
+	obs_data_set_int(data, "queued_video", queue.video_frames);
+	obs_data_set_int(data, "queued_audio", queue.audio_frames);
+}
+
+static void log_summary(obs_data_t *stats)
+{
+	blog(LOG_INFO,
+	     "[NDI stats] '%s' (%s): video %lld (SDK dropped %lld, "
+	     "discarded %lld), audio %lld (SDK dropped %lld), queued %lld/%lld, "
+	     "latency %.1f/%.1f ms, conversion %.2f/%.2f ms (avg/max)",
+	     obs_data_get_string(stats, "name"),
+	     obs_data_get_string(stats, "ndi_name"),
+	     obs_data_get_int(stats, "video_frames"),
+	     obs_data_get_int(stats, "sdk_video_dropped"),
+	     obs_data_get_int(stats, "video_discarded"),
+	     obs_data_get_int(stats, "audio_frames"),
+	     obs_data_get_int(stats, "sdk_audio_dropped"),
+	     obs_data_get_int(stats, "queued_video"),
+	     obs_data_get_int(stats, "queued_audio"),
+	     obs_data_get_double(stats, "latency_avg_ms"),
+	     obs_data_get_double(stats, "latency_max_ms"),
+	     obs_data_get_double(stats, "convert_avg_ms"),
+	     obs_data_get_double(stats, "convert_max_ms"));
+}
+
+// Frames received by all sources and number of sources at the last write
+static uint64_t written_frames;
+static size_t written_sources;
+
+static void collect(char *path, bool log)
+{
+	obs_data_t *root = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	uint64_t frames = 0;
+
+	pthread_mutex_lock(&stats_mutex);
+	const size_t source_count = stats_sources.size();
+	for (auto &src : stats_sources) {
+		obs_data_t *stats = obs_data_create();
+		src.cb(src.param, stats);
+		obs_data_array_push_back(sources, stats);
+		frames += (uint64_t)obs_data_get_int(stats, "video_frames") +
+			  (uint64_t)obs_data_get_int(stats, "audio_frames");
+		if (log)
+			log_summary(stats);
+		obs_data_release(stats);
+	}
+	pthread_mutex_unlock(&stats_mutex);
+
+	if (frames == written_frames && source_count == written_sources)
+		path = nullptr;
+	written_frames = frames;
+	written_sources = source_count;
+
+	obs_data_set_int(root, "timestamp_ms",
+			 std::chrono::duration_cast<std::chrono::milliseconds>(
+				 std::chrono::system_clock::now()
+					 .time_since_epoch())
+				 .count());
+	obs_data_set_array(root, "sources", sources);
+
+	if (path && !obs_data_save_json_safe(root, path, "tmp", "bak"))
+		blog(LOG_WARNING, "[NDI stats] can't write '%s'", path);
+
+	obs_data_array_release(sources);
+	obs_data_release(root);
+}
+
+static void *ndi_stats_thread(void *)
+{
+	os_set_thread_name("NDI stats");
+
+	char *path = obs_module_config_path("stats.json");
+	char *dir = obs_module_config_path("");
+	if (dir)
+		os_mkdirs(dir);
+	bfree(dir);
+
+	unsigned int ticks = 0;
+	while (os_event_timedwait(stats_stop_event, STATS_FILE_INTERVAL_MS) ==
+	       ETIMEDOUT) {
+		const bool log = (++ticks % STATS_LOG_EVERY) == 0;
+		collect(path, log);
+	}
+
+	bfree(path);
+	return nullptr;
+}
+
+void ndi_stats_register(void *param, ndi_stats_snapshot_cb cb)
+{
+	pthread_mutex_lock(&stats_mutex);
+	stats_sources.push_back({param, cb});
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+void ndi_stats_unregister(void *param)
+{
+	pthread_mutex_lock(&stats_mutex);
+	for (auto it = stats_sources.begin(); it != stats_sources.end();
+	     ++it) {
+		if (it->param == param) {
+			stats_sources.erase(it);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+void ndi_stats_init()
+{
+	if (os_event_init(&stats_stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return;
+
+	stats_running = pthread_create(&stats_thread, nullptr,
+				       ndi_stats_thread, nullptr) == 0;
+}
+
+void ndi_stats_shutdown()
+{
+	if (stats_running) {
+		os_event_signal(stats_stop_event);
+		pthread_join(stats_thread, nullptr);
+		stats_running = false;
+	}
+
+	if (stats_stop_event) {
+		os_event_destroy(stats_stop_event);
+		stats_stop_event = nullptr;
+	}
+}
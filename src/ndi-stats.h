@@ -0,0 +1,80 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+#include <atomic>
+
+#include "obs-ndi.h"
+
+// Per-source receive statistics. Counters are updated from the capture
+// threads with relaxed atomics; readers only need a consistent-enough
+// view for monitoring.
+struct ndi_stats_counters {
+	std::atomic<uint64_t> video_frames;
+	std::atomic<uint64_t> audio_frames;
+	// Received by the source but not handed to OBS
+	std::atomic<uint64_t> video_discarded;
+
+	// Capture of a video frame on the receive thread to its hand-off to
+	// OBS, in ns. Not measured for frame sync sources.
+	std::atomic<uint64_t> latency_total;
+	std::atomic<uint64_t> latency_count;
+	std::atomic<uint64_t> latency_max;
+
+	// Conversion and output of a video frame on the receive thread
+	std::atomic<uint64_t> convert_total;
+	std::atomic<uint64_t> convert_count;
+	std::atomic<uint64_t> convert_max;
+};
+
+static inline void ndi_stats_add(std::atomic<uint64_t> &counter,
+				 uint64_t val = 1)
+{
+	counter.fetch_add(val, std::memory_order_relaxed);
+}
+
+static inline void ndi_stats_add_max(std::atomic<uint64_t> &max, uint64_t val)
+{
+	uint64_t cur = max.load(std::memory_order_relaxed);
+	while (val > cur && !max.compare_exchange_weak(
+				    cur, val, std::memory_order_relaxed))
+		;
+}
+
+void ndi_stats_add_latency(struct ndi_stats_counters *c, uint64_t ns);
+void ndi_stats_add_convert(struct ndi_stats_counters *c, uint64_t ns);
+
+// Writes the counters, and the SDK side performance and queue figures of
+// 'recv' when not null, into 'data'
+void ndi_stats_fill(obs_data_t *data, const struct ndi_stats_counters *c,
+		    NDIlib_recv_instance_t recv);
+
+// Sources register a callback filling their current stats. They are
+// collected every few seconds into a JSON file in the module config
+// directory, and summarized in the log every minute. The file is only
+// rewritten when frames were received or the list of sources changed.
+typedef void (*ndi_stats_snapshot_cb)(void *param, obs_data_t *data);
+
+void ndi_stats_register(void *param, ndi_stats_snapshot_cb cb);
+// Once this returns, the callback is not running and won't run again
+void ndi_stats_unregister(void *param);
+
+void ndi_stats_init();
+void ndi_stats_shutdown();
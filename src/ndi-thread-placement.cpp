@@ -0,0 +1,438 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <obs-module.h>
+#include <string>
+
+#include "ndi-thread-placement.h"
+
+// SCHED_FIFO priority of realtime threads: above default realtime audio
+// servers' clients, below their own threads
+#define NDI_THREAD_FIFO_PRIORITY 10
+#define NDI_THREAD_HIGH_NICE -10
+
+#ifdef __linux__
+// From linux/mempolicy.h, allocate on the node of the running CPU
+#define NDI_MPOL_LOCAL 4
+#endif
+
+static struct ndi_thread_placement defaults[NDI_THREAD_KIND_COUNT];
+static bool numa_local;
+
+// Fields of the calling thread's placement that were changed from the
+// process defaults, to undo them when they become default again
+static thread_local bool moved_cpus;
+static thread_local bool moved_priority;
+
+static const char *kind_names[NDI_THREAD_KIND_COUNT] = {"receive", "output",
+							"filter"};
+
+static const char *priority_name(enum ndi_thread_priority priority)
+{
+	switch (priority) {
+	case NDI_THREAD_PRIORITY_NORMAL:
+		return "normal";
+	case NDI_THREAD_PRIORITY_HIGH:
+		return "high";
+	case NDI_THREAD_PRIORITY_REALTIME:
+		return "realtime";
+	default:
+		return "default";
+	}
+}
+
+static enum ndi_thread_priority priority_from_name(const char *name)
+{
+	for (int p = NDI_THREAD_PRIORITY_NORMAL;
+	     p <= NDI_THREAD_PRIORITY_REALTIME; ++p) {
+		if (strcmp(name, priority_name((enum ndi_thread_priority)p)) ==
+		    0)
+			return (enum ndi_thread_priority)p;
+	}
+	return NDI_THREAD_PRIORITY_DEFAULT;
+}
+
+bool ndi_thread_parse_cpus(const char *spec, uint64_t *cpus)
+{
+	*cpus = 0;
+	if (!spec)
+		return true;
+
+	uint64_t mask = 0;
+	const char *p = spec;
+	for (;;) {
+		while (*p == ' ' || *p == ',')
+			p++;
+		if (!*p) {
+			*cpus = mask;
+			return true;
+		}
+
+		char *end;
+		const long first = strtol(p, &end, 10);
+		if (end == p)
+			return false;
+		long last = first;
+		p = end;
+
+		if (*p == '-') {
+			last = strtol(p + 1, &end, 10);
+			if (end == p + 1)
+				return false;
+			p = end;
+		}
+
+		if (first < 0 || last < first || last > 63)
+			return false;
+		for (long cpu = first; cpu <= last; ++cpu)
+			mask |= 1ULL << cpu;
+
+		if (*p && *p != ',' && *p != ' ')
+			return false;
+	}
+}
+
+static std::string format_cpus(uint64_t cpus)
+{
+	if (!cpus)
+		return "any";
+
+	std::string str;
+	for (int cpu = 0; cpu < 64; ++cpu) {
+		if (!(cpus & (1ULL << cpu)))
+			continue;
+
+		int last = cpu;
+		while (last < 63 && (cpus & (1ULL << (last + 1))))
+			last++;
+
+		if (!str.empty())
+			str += ',';
+		str += std::to_string(cpu);
+		if (last > cpu)
+			str += '-' + std::to_string(last);
+		cpu = last;
+	}
+	return str;
+}
+
+void ndi_thread_placement_init()
+{
+	char *path = obs_module_config_path("thread-placement.json");
+	obs_data_t *data =
+		path ? obs_data_create_from_json_file_safe(path, "bak")
+		     : nullptr;
+	bfree(path);
+	if (!data)
+		return;
+
+	for (int kind = 0; kind < NDI_THREAD_KIND_COUNT; ++kind) {
+		obs_data_t *item = obs_data_get_obj(data, kind_names[kind]);
+		if (!item)
+			continue;
+
+		struct ndi_thread_placement *p = &defaults[kind];
+		const char *cpus = obs_data_get_string(item, "cpus");
+		if (!ndi_thread_parse_cpus(cpus, &p->cpus))
+			blog(LOG_WARNING,
+			     "thread placement: invalid %s cpus '%s'",
+			     kind_names[kind], cpus);
+		p->priority = priority_from_name(
+			obs_data_get_string(item, "priority"));
+		obs_data_release(item);
+	}
+
+	numa_local = obs_data_get_bool(data, "numa_local");
+	obs_data_release(data);
+}
+
+#ifdef _WIN32
+static bool set_affinity(uint64_t cpus)
+{
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpus) != 0;
+}
+
+static bool set_priority(enum ndi_thread_priority priority)
+{
+	int value = THREAD_PRIORITY_NORMAL;
+	if (priority == NDI_THREAD_PRIORITY_HIGH)
+		value = THREAD_PRIORITY_ABOVE_NORMAL;
+	else if (priority == NDI_THREAD_PRIORITY_REALTIME)
+		value = THREAD_PRIORITY_TIME_CRITICAL;
+	return SetThreadPriority(GetCurrentThread(), value) != 0;
+}
+
+// Windows already prefers the node of the running CPU
+static bool set_numa_local()
+{
+	return true;
+}
+
+static uint64_t get_affinity(uint64_t requested)
+{
+	return requested;
+}
+
+static bool reset_affinity()
+{
+	DWORD_PTR process, system;
+	return GetProcessAffinityMask(GetCurrentProcess(), &process,
+				      &system) &&
+	       SetThreadAffinityMask(GetCurrentThread(), process) != 0;
+}
+
+struct ndi_thread_saved {
+	HANDLE thread;
+	DWORD_PTR cpus;
+	int priority;
+};
+
+struct ndi_thread_saved *ndi_thread_save()
+{
+	auto saved = (struct ndi_thread_saved *)bzalloc(
+		sizeof(struct ndi_thread_saved));
+	DuplicateHandle(GetCurrentProcess(), GetCurrentThread(),
+			GetCurrentProcess(), &saved->thread,
+			THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION,
+			FALSE, 0);
+	saved->priority = GetThreadPriority(GetCurrentThread());
+
+	// There is no getter for the thread affinity, only the setter
+	// returns the previous one
+	DWORD_PTR process, system;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) {
+		saved->cpus = SetThreadAffinityMask(GetCurrentThread(),
+						    process);
+		if (saved->cpus)
+			SetThreadAffinityMask(GetCurrentThread(), saved->cpus);
+	}
+	return saved;
+}
+
+void ndi_thread_restore(struct ndi_thread_saved *saved)
+{
+	if (!saved)
+		return;
+
+	if (saved->thread) {
+		if (saved->cpus)
+			SetThreadAffinityMask(saved->thread, saved->cpus);
+		SetThreadPriority(saved->thread, saved->priority);
+		CloseHandle(saved->thread);
+	}
+	bfree(saved);
+}
+#else
+static bool set_affinity(uint64_t cpus)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu = 0; cpu < 64; ++cpu) {
+		if (cpus & (1ULL << cpu))
+			CPU_SET(cpu, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	// No hard affinity on macOS
+	UNUSED_PARAMETER(cpus);
+	errno = ENOTSUP;
+	return false;
+#endif
+}
+
+static bool set_priority(enum ndi_thread_priority priority)
+{
+	struct sched_param param = {};
+	if (priority == NDI_THREAD_PRIORITY_REALTIME) {
+		param.sched_priority = NDI_THREAD_FIFO_PRIORITY;
+		errno = pthread_setschedparam(pthread_self(), SCHED_FIFO,
+					      &param);
+		return errno == 0;
+	}
+
+	errno = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	if (errno != 0)
+		return false;
+
+#ifdef __linux__
+	// Nice values are per thread on Linux
+	const int nice = priority == NDI_THREAD_PRIORITY_HIGH
+				 ? NDI_THREAD_HIGH_NICE
+				 : 0;
+	return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+#else
+	return priority == NDI_THREAD_PRIORITY_NORMAL;
+#endif
+}
+
+static bool set_numa_local()
+{
+#ifdef __linux__
+	return syscall(SYS_set_mempolicy, NDI_MPOL_LOCAL, nullptr, 0) == 0;
+#else
+	return false;
+#endif
+}
+
+static uint64_t get_affinity(uint64_t requested)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		return requested;
+
+	uint64_t cpus = 0;
+	for (int cpu = 0; cpu < 64; ++cpu) {
+		if (CPU_ISSET(cpu, &set))
+			cpus |= 1ULL << cpu;
+	}
+	return cpus;
+#else
+	return requested;
+#endif
+}
+
+static bool reset_affinity()
+{
+#ifdef __linux__
+	// The main thread keeps the affinity the process was started with
+	cpu_set_t set;
+	if (sched_getaffinity(getpid(), sizeof(set), &set) != 0)
+		return false;
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return true;
+#endif
+}
+
+struct ndi_thread_saved {
+	pthread_t thread;
+	int policy;
+	struct sched_param param;
+#ifdef __linux__
+	pid_t tid;
+	cpu_set_t cpus;
+	bool cpus_valid;
+	int nice;
+#endif
+};
+
+struct ndi_thread_saved *ndi_thread_save()
+{
+	auto saved = (struct ndi_thread_saved *)bzalloc(
+		sizeof(struct ndi_thread_saved));
+	saved->thread = pthread_self();
+	if (pthread_getschedparam(saved->thread, &saved->policy,
+				  &saved->param) != 0)
+		saved->policy = SCHED_OTHER;
+
+#ifdef __linux__
+	saved->tid = (pid_t)syscall(SYS_gettid);
+	saved->cpus_valid = pthread_getaffinity_np(saved->thread,
+						   sizeof(saved->cpus),
+						   &saved->cpus) == 0;
+	errno = 0;
+	saved->nice = getpriority(PRIO_PROCESS, (id_t)saved->tid);
+	if (errno != 0)
+		saved->nice = 0;
+#endif
+	return saved;
+}
+
+void ndi_thread_restore(struct ndi_thread_saved *saved)
+{
+	if (!saved)
+		return;
+
+	pthread_setschedparam(saved->thread, saved->policy, &saved->param);
+#ifdef __linux__
+	if (saved->cpus_valid)
+		pthread_setaffinity_np(saved->thread, sizeof(saved->cpus),
+				       &saved->cpus);
+	if (saved->policy == SCHED_OTHER)
+		setpriority(PRIO_PROCESS, (id_t)saved->tid, saved->nice);
+#endif
+	bfree(saved);
+}
+#endif
+
+void ndi_thread_place(enum ndi_thread_kind kind,
+		      const struct ndi_thread_placement *override,
+		      const char *name)
+{
+	struct ndi_thread_placement p = defaults[kind];
+	if (override && override->cpus)
+		p.cpus = override->cpus;
+	if (override && override->priority != NDI_THREAD_PRIORITY_DEFAULT)
+		p.priority = override->priority;
+
+	if (!p.cpus && moved_cpus) {
+		if (!reset_affinity())
+			blog(LOG_WARNING, "%s: can't reset CPU affinity (%s)",
+			     name, strerror(errno));
+		moved_cpus = false;
+	}
+
+	if (p.priority == NDI_THREAD_PRIORITY_DEFAULT && moved_priority) {
+		if (!set_priority(NDI_THREAD_PRIORITY_NORMAL))
+			blog(LOG_WARNING, "%s: can't reset priority (%s)",
+			     name, strerror(errno));
+		moved_priority = false;
+	}
+
+	if (!p.cpus && p.priority == NDI_THREAD_PRIORITY_DEFAULT &&
+	    !numa_local)
+		return;
+
+	if (p.cpus) {
+		if (!set_affinity(p.cpus))
+			blog(LOG_WARNING,
+			     "%s: can't set CPU affinity to %s (%s)", name,
+			     format_cpus(p.cpus).c_str(), strerror(errno));
+		moved_cpus = true;
+	}
+
+	if (p.priority != NDI_THREAD_PRIORITY_DEFAULT) {
+		if (!set_priority(p.priority))
+			blog(LOG_WARNING, "%s: can't set %s priority (%s)",
+			     name, priority_name(p.priority), strerror(errno));
+		moved_priority = true;
+	}
+
+	const bool numa = numa_local && set_numa_local();
+
+	blog(LOG_INFO, "%s: %s thread on CPUs %s, %s priority%s", name,
+	     kind_names[kind], format_cpus(get_affinity(p.cpus)).c_str(),
+	     priority_name(p.priority), numa ? ", NUMA-local memory" : "");
+}
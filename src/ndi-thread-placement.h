@@ -0,0 +1,70 @@
+/*
+obs-ndi
+Copyright (C) 2016-2023 Stéphane Lepin <stephane.lepin@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// CPU placement of the plugin's worker threads: affinity, scheduling
+// priority and NUMA-local allocation.
+//
+// Global defaults per kind of thread are read from thread-placement.json
+// in the module config directory, e.g.
+//   {"receive": {"cpus": "8-15", "priority": "high"},
+//    "filter": {"cpus": "16-19"}, "numa_local": true}
+// Sources can override them for their receiver threads.
+enum ndi_thread_kind {
+	NDI_THREAD_RECEIVE,
+	NDI_THREAD_OUTPUT,
+	NDI_THREAD_FILTER,
+	NDI_THREAD_KIND_COUNT,
+};
+
+enum ndi_thread_priority {
+	NDI_THREAD_PRIORITY_DEFAULT,
+	NDI_THREAD_PRIORITY_NORMAL,
+	NDI_THREAD_PRIORITY_HIGH,
+	NDI_THREAD_PRIORITY_REALTIME,
+};
+
+struct ndi_thread_placement {
+	// Bit n allows CPU n. 0, or DEFAULT priority, keep the global setting.
+	uint64_t cpus;
+	enum ndi_thread_priority priority;
+};
+
+// Parses a CPU list such as "0-3,8,10-11" (CPUs 0 to 63). An empty
+// list gives 0.
+bool ndi_thread_parse_cpus(const char *spec, uint64_t *cpus);
+
+void ndi_thread_placement_init();
+
+// Applies the placement for 'kind', with the non-default fields of
+// 'override' (may be null) taking precedence, to the calling thread and
+// logs the resulting placement. A thread placed earlier goes back to the
+// process CPUs and normal priority for the fields that became default.
+void ndi_thread_place(enum ndi_thread_kind kind,
+		      const struct ndi_thread_placement *override,
+		      const char *name);
+
+// Affinity and priority of the calling thread, for threads the plugin
+// doesn't own. ndi_thread_restore puts them back from any thread and
+// frees the saved state.
+struct ndi_thread_saved;
+struct ndi_thread_saved *ndi_thread_save();
+void ndi_thread_restore(struct ndi_thread_saved *saved);
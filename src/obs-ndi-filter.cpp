@@ -28,6 +28,7 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <media-io/audio-resampler.h>
 
 #include "obs-ndi.h"
+#include "ndi-thread-placement.h"
 
 #define TEXFORMAT GS_BGRA
 #define FLT_PROP_NAME "ndi_filter_ndiname"
@@ -49,6 +50,7 @@ struct ndi_filter {
 	uint32_t video_linesize;
 
 	video_t *video_output;
+	bool video_thread_placed;
 	bool is_audioonly;
 
 	os_performance_token_t *perf_token;
@@ -130,6 +132,13 @@ void ndi_filter_raw_video(void *data, video_data *frame)
 	if (!frame || !frame->data[0])
 		return;
 
+	// Runs on the thread of our own video output, which sends to NDI
+	if (!s->video_thread_placed) {
+		ndi_thread_place(NDI_THREAD_FILTER, nullptr,
+				 obs_source_get_name(s->context));
+		s->video_thread_placed = true;
+	}
+
 	NDIlib_video_frame_v2_t video_frame = {0};
 	video_frame.xres = s->known_width;
 	video_frame.yres = s->known_height;
@@ -199,6 +208,7 @@ void ndi_filter_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 
 			video_output_close(s->video_output);
 			video_output_open(&s->video_output, &vi);
+			s->video_thread_placed = false;
 			video_output_connect(s->video_output, nullptr,
 					     ndi_filter_raw_video, s);
 
@@ -22,7 +22,10 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <util/profiler.h>
 #include <util/circlebuf.h>
 
+#include <atomic>
+
 #include "obs-ndi.h"
+#include "ndi-thread-placement.h"
 
 static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 {
@@ -88,6 +91,60 @@ struct ndi_output {
 	os_performance_token_t *perf_token;
 };
 
+// Raw data comes from libobs' video and audio output threads, shared with
+// other outputs. They are moved, when an output placement is configured
+// globally, while NDI outputs are running and put back as they were when
+// the last one stops.
+struct ndi_output_thread {
+	const char *name;
+	std::atomic<bool> placed;
+	long outputs;
+	struct ndi_thread_saved *saved;
+};
+
+static pthread_mutex_t output_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ndi_output_thread output_video_thread = {"NDI output video"};
+static struct ndi_output_thread output_audio_thread = {"NDI output audio"};
+
+static void ndi_output_place_thread(struct ndi_output_thread *t)
+{
+	if (t->placed.load(std::memory_order_acquire))
+		return;
+
+	pthread_mutex_lock(&output_threads_mutex);
+	if (t->outputs && !t->placed) {
+		t->saved = ndi_thread_save();
+		ndi_thread_place(NDI_THREAD_OUTPUT, nullptr, t->name);
+		t->placed.store(true, std::memory_order_release);
+	}
+	pthread_mutex_unlock(&output_threads_mutex);
+}
+
+static void ndi_output_threads_hold()
+{
+	pthread_mutex_lock(&output_threads_mutex);
+	output_video_thread.outputs++;
+	output_audio_thread.outputs++;
+	pthread_mutex_unlock(&output_threads_mutex);
+}
+
+// After obs_output_end_data_capture, once no callback of the output runs
+static void ndi_output_threads_release()
+{
+	struct ndi_output_thread *threads[] = {&output_video_thread,
+					       &output_audio_thread};
+
+	pthread_mutex_lock(&output_threads_mutex);
+	for (struct ndi_output_thread *t : threads) {
+		if (--t->outputs || !t->placed)
+			continue;
+		ndi_thread_restore(t->saved);
+		t->saved = nullptr;
+		t->placed.store(false, std::memory_order_release);
+	}
+	pthread_mutex_unlock(&output_threads_mutex);
+}
+
 const char *ndi_output_getname(void *data)
 {
 	UNUSED_PARAMETER(data);
@@ -206,10 +263,12 @@ bool ndi_output_start(void *data)
 		}
 		o->perf_token = os_request_high_performance("NDI Output");
 
+		ndi_output_threads_hold();
 		o->started = obs_output_begin_data_capture(o->output, flags);
 		if (o->started) {
 			blog(LOG_INFO, "'%s': ndi output started", o->ndi_name);
 		} else {
+			ndi_output_threads_release();
 			blog(LOG_ERROR, "'%s': data capture start failed",
 			     o->ndi_name);
 		}
@@ -238,6 +297,7 @@ void ndi_output_stop(void *data, uint64_t ts)
 	o->started = false;
 
 	obs_output_end_data_capture(o->output);
+	ndi_output_threads_release();
 
 	if (o->perf_token) {
 		os_end_high_performance(o->perf_token);
@@ -306,6 +366,8 @@ void ndi_output_rawvideo(void *data, struct video_data *frame)
 	if (!o->started || !o->frame_width || !o->frame_height)
 		return;
 
+	ndi_output_place_thread(&output_video_thread);
+
 	uint32_t width = o->frame_width;
 	uint32_t height = o->frame_height;
 
@@ -339,6 +401,8 @@ void ndi_output_rawaudio(void *data, struct audio_data *frame)
 	if (!o->started || !o->audio_samplerate || !o->audio_channels)
 		return;
 
+	ndi_output_place_thread(&output_audio_thread);
+
 	NDIlib_audio_frame_v2_t audio_frame = {0};
 	audio_frame.sample_rate = o->audio_samplerate;
 	audio_frame.no_channels = (int)o->audio_channels;
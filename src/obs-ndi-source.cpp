@@ -20,13 +20,25 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <Windows.h>
 #endif
 
+#include <atomic>
+
 #include <obs-module.h>
 #include <util/platform.h>
 #include <util/threading.h>
-#include <chrono>
-#include <thread>
+#include <media-io/audio-resampler.h>
 
 #include "obs-ndi.h"
+#include "frame-render.h"
+#include "ndi-receiver-pool.h"
+#include "ndi-convert.h"
+#include "ndi-deinterlace.h"
+#include "ndi-stats.h"
+#include "ndi-clock.h"
+#include "ndi-audio-matrix.h"
+#include "ndi-discovery.h"
+#include "ndi-frame-pool.h"
+#include "ndi-genlock.h"
+#include "ndi-scale.h"
 
 #define PROP_SOURCE "ndi_source_name"
 #define PROP_BANDWIDTH "ndi_bw_mode"
@@ -37,10 +49,30 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #define PROP_YUV_COLORSPACE "yuv_colorspace"
 #define PROP_LATENCY "latency"
 #define PROP_AUDIO "ndi_audio"
+#define PROP_IDLE_WAIT "ndi_idle_wait_ms"
+#define PROP_COLOR_FORMAT "ndi_color_format"
+#define PROP_DEINTERLACE "ndi_deinterlace"
+#define PROP_CLOCK_RECOVERY "ndi_clock_recovery"
+#define PROP_AUDIO_MATRIX "ndi_audio_matrix"
+#define PROP_AUDIO_RESAMPLE "ndi_audio_resample"
+#define PROP_MAX_QUEUE "ndi_max_queued_frames"
+#define PROP_THREAD_CPUS "ndi_thread_cpus"
+#define PROP_THREAD_PRIORITY "ndi_thread_priority"
+#define PROP_SYNC_DELIVERY "ndi_sync_delivery"
+#define PROP_GENLOCK_GROUP "ndi_genlock_group"
+#define PROP_TARGET_WIDTH "ndi_target_width"
+#define PROP_TARGET_HEIGHT "ndi_target_height"
+#define PROP_CROP_LEFT "ndi_crop_left"
+#define PROP_CROP_TOP "ndi_crop_top"
+#define PROP_CROP_RIGHT "ndi_crop_right"
+#define PROP_CROP_BOTTOM "ndi_crop_bottom"
+#define PROP_BACKUP_SOURCE "ndi_backup_source_name"
+#define PROP_FAILOVER_TIMEOUT "ndi_failover_timeout_ms"
 
 #define PROP_BW_HIGHEST 0
 #define PROP_BW_LOWEST 1
 #define PROP_BW_AUDIO_ONLY 2
+#define PROP_BW_AUTO 3
 
 #define PROP_SYNC_INTERNAL 0
 #define PROP_SYNC_NDI_TIMESTAMP 1
@@ -55,20 +87,154 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #define PROP_LATENCY_NORMAL 0
 #define PROP_LATENCY_LOW 1
 
-extern NDIlib_find_instance_t ndi_finder;
+#define PROP_COLOR_FORMAT_UYVY_BGRA 0
+#define PROP_COLOR_FORMAT_HIGH_BIT_DEPTH 1
+#define PROP_COLOR_FORMAT_FAST 2
+
+#define PROP_SYNC_DELIVERY_FRAMESYNC 0
+#define PROP_SYNC_DELIVERY_RING 1
+
+// Automatic bandwidth: time a source must stay hidden before dropping to
+// the lowest bandwidth. A pre-warmed receiver (bandwidth switch or
+// settings change) that doesn't deliver its first frame within the
+// timeout replaces the active one anyway.
+#define BW_AUTO_HOLD_NS 2000000000ULL
+#define PREWARM_TIMEOUT_NS 3000000000ULL
+
+// Failover: time a newly created active receiver gets to find its sender
+// and deliver a first frame, before the failover timeout applies
+#define FAILOVER_CONNECT_GRACE_NS 5000000000ULL
+
+// Frames a sync source in receive ring mode keeps between two renders
+#define SYNC_RING_SIZE 3
+
+struct ndi_ring_entry {
+	struct ndi_pooled_frame *frame;
+	struct obs_source_frame info;
+};
 
 struct ndi_source {
 	obs_source_t *source;
-	NDIlib_recv_instance_t ndi_receiver;
-	int sync_mode;
-	video_range_type yuv_range;
-	video_colorspace yuv_colorspace;
-	pthread_t av_thread;
-	bool running;
-	NDIlib_tally_t tally;
+	struct ndi_receiver *receiver;
+
+	// Receiver changes (update, bandwidth switches, destroy)
+	pthread_mutex_t receiver_mutex;
+	struct ndi_receiver_desc recv_desc;
+	char *ndi_name;
+
+	// Automatic bandwidth and settings changes. A receiver for the new
+	// stream is connected next to the active one and takes over with its
+	// first video frame. receiver, pending_receiver and pending_ready are
+	// guarded by both video_mutex and audio_mutex, which the capture
+	// callbacks hold.
+	bool bw_auto;
+	uint64_t bw_hidden_since;
+	struct ndi_receiver *pending_receiver;
+	uint64_t pending_since;
+	bool pending_ready;
+	bool pending_rebuild;
+	pthread_mutex_t video_mutex;
+	pthread_mutex_t audio_mutex;
+
+	// Failover of async sources. The standby receiver stays connected
+	// to the backup sender at the lowest bandwidth, without subscribing,
+	// and becomes the active one as soon as the active sender is lost.
+	// last_video_ns is the arrival of the last frame shown, 0 until the
+	// active receiver delivers one. failed_over is set while the backup
+	// from the settings is the active sender and the primary the standby.
+	// Once failed over, recv_desc.bandwidth is the lowest until a
+	// receiver at configured_bandwidth takes over.
+	char *backup_name;
+	bool failed_over;
+	NDIlib_recv_bandwidth_e configured_bandwidth;
+	struct ndi_receiver *standby_receiver;
+	uint64_t failover_timeout_ns;
+	uint64_t active_since;
+	std::atomic<uint64_t> last_video_ns;
+
+	struct ndi_stats_counters stats;
+
+	// Sender time to OBS time mapping, shared by audio and video
+	std::atomic<bool> clock_recovery;
+	struct ndi_clock clock;
+	uint64_t video_arrival_ns;
+	// When the SDK returned the frame being output, for the latency stat
+	uint64_t video_capture_ns;
+
+	// Channel matrix, guarded by audio_mutex, and its output planes
+	struct ndi_audio_matrix audio_matrix;
+	bool audio_clamp_warned;
+	float *audio_buffer;
+	size_t audio_buffer_frames;
+
+	// Conversion to the OBS sample rate on the capture thread, instead
+	// of on the OBS audio thread. Guarded by audio_mutex.
+	bool audio_resample;
+	audio_resampler_t *resampler;
+	struct resample_info resample_src;
+	uint32_t resample_dst_rate;
+
+	// Changed live by update while the capture threads read them
+	std::atomic<int> sync_mode;
+	std::atomic<video_range_type> yuv_range;
+	std::atomic<video_colorspace> yuv_colorspace;
+	std::atomic<bool> audio_enabled;
+
+	bool on_preview;
+	bool on_program;
 	bool alpha_filter_enabled;
-	bool audio_enabled;
-	os_performance_token_t *perf_token;
+
+	// Buffers for frames that need repacking before libobs can take
+	// them. conv_frame holds the planes of the frame being output and is
+	// only touched from the thread delivering video.
+	struct ndi_frame_pool *frame_pool;
+	struct ndi_pooled_frame *conv_frame;
+
+	// Region of interest and downscaling of frames larger than needed,
+	// on the same thread as conv_frame. A target of 0 leaves a dimension
+	// unconstrained.
+	std::atomic<uint32_t> crop_left;
+	std::atomic<uint32_t> crop_top;
+	std::atomic<uint32_t> crop_right;
+	std::atomic<uint32_t> crop_bottom;
+	struct ndi_scaler *scaler;
+	std::atomic<uint32_t> target_width;
+	std::atomic<uint32_t> target_height;
+
+	// Field handling, also only touched from the video thread
+	struct ndi_deinterlacer *deinterlacer;
+	std::atomic<ndi_deinterlace_mode> deinterlace_mode;
+
+	// Synchronous (FrameSync) mode: frames are pulled on the OBS
+	// graphics thread instead of being pushed by the receiver threads
+	bool is_sync;
+	NDIlib_framesync_instance_t ndi_framesync;
+	struct ndi_receiver *framesync_receiver;
+	pthread_mutex_t framesync_mutex;
+	struct frame_render *render;
+	int64_t sync_last_video_timestamp;
+	bool sync_clear_video;
+	double sync_audio_remainder;
+	uint64_t sync_audio_next_ts;
+
+	// Receive ring mode of sync sources: the receiver threads push
+	// frames, oldest first, and the render thread uploads the newest one
+	// due at each OBS frame. Copying into the ring replaces the copy into
+	// the libobs async cache.
+	std::atomic<bool> ring_mode;
+	pthread_mutex_t ring_mutex;
+	struct ndi_frame_pool *ring_pool;
+	struct ndi_ring_entry ring[SYNC_RING_SIZE];
+	size_t ring_count;
+	uint64_t ring_render_time;
+
+	// Genlock group joined, only in frame sync mode. Guarded by
+	// receiver_mutex.
+	char *genlock_group;
+
+	// Next metadata frame to signal, only touched by the tick
+	struct ndi_receiver *metadata_receiver;
+	uint64_t metadata_next;
 };
 
 static obs_source_t *find_filter_by_id(obs_source_t *context, const char *id)
@@ -164,9 +330,21 @@ const char *ndi_source_getname(void *data)
 	return obs_module_text("NDIPlugin.NDISourceName");
 }
 
-obs_properties_t *ndi_source_getproperties(void *data)
+const char *ndi_source_sync_getname(void *data)
 {
 	UNUSED_PARAMETER(data);
+	return obs_module_text("NDIPlugin.NDISyncSourceName");
+}
+
+static void ndi_source_list_add(void *param, const char *name)
+{
+	obs_property_list_add_string((obs_property_t *)param, name, name);
+}
+
+obs_properties_t *ndi_source_getproperties(void *data)
+{
+	auto s = (struct ndi_source *)data;
+	const bool is_sync = s && s->is_sync;
 
 	obs_properties_t *props = obs_properties_create();
 	obs_properties_set_flags(props, OBS_PROPERTIES_DEFER_UPDATE);
@@ -176,14 +354,27 @@ obs_properties_t *ndi_source_getproperties(void *data)
 		obs_module_text("NDIPlugin.SourceProps.SourceName"),
 		OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
 
-	uint32_t nbSources = 0;
-	const NDIlib_source_t *sources =
-		ndiLib->find_get_current_sources(ndi_finder, &nbSources);
+	ndi_discovery_enum(nullptr, ndi_source_list_add, source_list);
 
-	for (uint32_t i = 0; i < nbSources; ++i) {
-		obs_property_list_add_string(source_list, sources[i].p_ndi_name,
-					     sources[i].p_ndi_name);
-	}
+	obs_property_t *backup_list = obs_properties_add_list(
+		props, PROP_BACKUP_SOURCE,
+		obs_module_text("NDIPlugin.SourceProps.BackupSourceName"),
+		OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(
+		backup_list, obs_module_text("NDIPlugin.SourceProps.NoBackup"),
+		"");
+	ndi_discovery_enum(nullptr, ndi_source_list_add, backup_list);
+	obs_property_set_long_description(
+		backup_list,
+		obs_module_text("NDIPlugin.SourceProps.BackupSourceName.Help"));
+	obs_property_set_visible(backup_list, !is_sync);
+
+	obs_property_t *failover_timeout = obs_properties_add_int(
+		props, PROP_FAILOVER_TIMEOUT,
+		obs_module_text("NDIPlugin.SourceProps.FailoverTimeout"), 50,
+		5000, 10);
+	obs_property_int_set_suffix(failover_timeout, " ms");
+	obs_property_set_visible(failover_timeout, !is_sync);
 
 	obs_property_t *bw_modes = obs_properties_add_list(
 		props, PROP_BANDWIDTH,
@@ -199,6 +390,10 @@ obs_properties_t *ndi_source_getproperties(void *data)
 	obs_property_list_add_int(bw_modes,
 				  obs_module_text("NDIPlugin.BWMode.AudioOnly"),
 				  PROP_BW_AUDIO_ONLY);
+	if (!is_sync)
+		obs_property_list_add_int(
+			bw_modes, obs_module_text("NDIPlugin.BWMode.Auto"),
+			PROP_BW_AUTO);
 
 	obs_property_set_modified_callback(
 		bw_modes, [](obs_properties_t *props, obs_property_t *property,
@@ -220,6 +415,30 @@ obs_properties_t *ndi_source_getproperties(void *data)
 			return true;
 		});
 
+	obs_property_t *color_formats = obs_properties_add_list(
+		props, PROP_COLOR_FORMAT,
+		obs_module_text("NDIPlugin.SourceProps.ColorFormat"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+
+	obs_property_list_add_int(
+		color_formats,
+		obs_module_text("NDIPlugin.SourceProps.ColorFormat.UYVYBGRA"),
+		PROP_COLOR_FORMAT_UYVY_BGRA);
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+	obs_property_list_add_int(
+		color_formats,
+		obs_module_text(
+			"NDIPlugin.SourceProps.ColorFormat.HighBitDepth"),
+		PROP_COLOR_FORMAT_HIGH_BIT_DEPTH);
+#endif
+	obs_property_list_add_int(
+		color_formats,
+		obs_module_text("NDIPlugin.SourceProps.ColorFormat.Fast"),
+		PROP_COLOR_FORMAT_FAST);
+
+	// Frame sync sources only render 8-bit formats
+	obs_property_set_visible(color_formats, !is_sync);
+
 	obs_property_t *sync_modes = obs_properties_add_list(
 		props, PROP_SYNC, obs_module_text("NDIPlugin.SourceProps.Sync"),
 		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
@@ -232,6 +451,40 @@ obs_properties_t *ndi_source_getproperties(void *data)
 		obs_module_text("NDIPlugin.SyncMode.NDISourceTimecode"),
 		PROP_SYNC_NDI_SOURCE_TIMECODE);
 
+	// Frame sync sources are clocked by OBS, sender timing is irrelevant
+	obs_property_set_visible(sync_modes, !is_sync);
+
+	obs_property_t *clock_recovery = obs_properties_add_bool(
+		props, PROP_CLOCK_RECOVERY,
+		obs_module_text("NDIPlugin.SourceProps.ClockRecovery"));
+	obs_property_set_visible(clock_recovery, !is_sync);
+
+	obs_property_t *sync_delivery = obs_properties_add_list(
+		props, PROP_SYNC_DELIVERY,
+		obs_module_text("NDIPlugin.SourceProps.SyncDelivery"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(
+		sync_delivery,
+		obs_module_text("NDIPlugin.SourceProps.SyncDelivery.FrameSync"),
+		PROP_SYNC_DELIVERY_FRAMESYNC);
+	obs_property_list_add_int(
+		sync_delivery,
+		obs_module_text("NDIPlugin.SourceProps.SyncDelivery.Ring"),
+		PROP_SYNC_DELIVERY_RING);
+	obs_property_set_long_description(
+		sync_delivery,
+		obs_module_text("NDIPlugin.SourceProps.SyncDelivery.Help"));
+	obs_property_set_visible(sync_delivery, is_sync);
+
+	obs_property_t *genlock_group = obs_properties_add_text(
+		props, PROP_GENLOCK_GROUP,
+		obs_module_text("NDIPlugin.SourceProps.GenlockGroup"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(
+		genlock_group,
+		obs_module_text("NDIPlugin.SourceProps.GenlockGroup.Help"));
+	obs_property_set_visible(genlock_group, is_sync);
+
 	obs_properties_add_bool(
 		props, PROP_HW_ACCEL,
 		obs_module_text("NDIPlugin.SourceProps.HWAccel"));
@@ -275,10 +528,135 @@ obs_properties_t *ndi_source_getproperties(void *data)
 		latency_modes,
 		obs_module_text("NDIPlugin.SourceProps.Latency.Low"),
 		PROP_LATENCY_LOW);
+	obs_property_set_visible(latency_modes, !is_sync);
+
+	obs_property_t *deinterlace_modes = obs_properties_add_list(
+		props, PROP_DEINTERLACE,
+		obs_module_text("NDIPlugin.SourceProps.Deinterlace"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+
+	obs_property_list_add_int(
+		deinterlace_modes,
+		obs_module_text("NDIPlugin.SourceProps.Deinterlace.Off"),
+		NDI_DEINTERLACE_OFF);
+	obs_property_list_add_int(
+		deinterlace_modes,
+		obs_module_text("NDIPlugin.SourceProps.Deinterlace.Weave"),
+		NDI_DEINTERLACE_WEAVE);
+	obs_property_list_add_int(
+		deinterlace_modes,
+		obs_module_text("NDIPlugin.SourceProps.Deinterlace.Bob"),
+		NDI_DEINTERLACE_BOB);
+	obs_property_list_add_int(
+		deinterlace_modes,
+		obs_module_text("NDIPlugin.SourceProps.Deinterlace.Adaptive"),
+		NDI_DEINTERLACE_ADAPTIVE);
+
+	// Frame sync always delivers progressive frames
+	obs_property_set_visible(deinterlace_modes, !is_sync);
 
 	obs_properties_add_bool(props, PROP_AUDIO,
 				obs_module_text("NDIPlugin.SourceProps.Audio"));
 
+	obs_property_t *audio_matrix = obs_properties_add_text(
+		props, PROP_AUDIO_MATRIX,
+		obs_module_text("NDIPlugin.SourceProps.AudioMatrix"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(
+		audio_matrix,
+		obs_module_text("NDIPlugin.SourceProps.AudioMatrix.Help"));
+
+	obs_property_t *audio_resample = obs_properties_add_bool(
+		props, PROP_AUDIO_RESAMPLE,
+		obs_module_text("NDIPlugin.SourceProps.AudioResample"));
+	obs_property_set_visible(audio_resample, !is_sync);
+
+	obs_property_t *max_queue = obs_properties_add_int(
+		props, PROP_MAX_QUEUE,
+		obs_module_text("NDIPlugin.SourceProps.MaxQueue"), 0, 30, 1);
+	obs_property_int_set_suffix(
+		max_queue,
+		obs_module_text("NDIPlugin.SourceProps.MaxQueue.Suffix"));
+	obs_property_set_long_description(
+		max_queue,
+		obs_module_text("NDIPlugin.SourceProps.MaxQueue.Help"));
+	obs_property_set_visible(max_queue, !is_sync);
+
+	static const struct {
+		const char *name;
+		const char *text;
+	} crop_edges[] = {
+		{PROP_CROP_LEFT, "NDIPlugin.SourceProps.CropLeft"},
+		{PROP_CROP_TOP, "NDIPlugin.SourceProps.CropTop"},
+		{PROP_CROP_RIGHT, "NDIPlugin.SourceProps.CropRight"},
+		{PROP_CROP_BOTTOM, "NDIPlugin.SourceProps.CropBottom"},
+	};
+	for (const auto &edge : crop_edges) {
+		obs_property_t *crop = obs_properties_add_int(
+			props, edge.name, obs_module_text(edge.text), 0, 8192,
+			1);
+		obs_property_int_set_suffix(crop, " px");
+		obs_property_set_long_description(
+			crop,
+			obs_module_text("NDIPlugin.SourceProps.Crop.Help"));
+	}
+
+	obs_property_t *target_width = obs_properties_add_int(
+		props, PROP_TARGET_WIDTH,
+		obs_module_text("NDIPlugin.SourceProps.TargetWidth"), 0, 8192,
+		1);
+	obs_property_int_set_suffix(target_width, " px");
+	obs_property_set_long_description(
+		target_width,
+		obs_module_text("NDIPlugin.SourceProps.TargetSize.Help"));
+
+	obs_property_t *target_height = obs_properties_add_int(
+		props, PROP_TARGET_HEIGHT,
+		obs_module_text("NDIPlugin.SourceProps.TargetHeight"), 0, 8192,
+		1);
+	obs_property_int_set_suffix(target_height, " px");
+	obs_property_set_long_description(
+		target_height,
+		obs_module_text("NDIPlugin.SourceProps.TargetSize.Help"));
+
+	obs_property_t *idle_wait = obs_properties_add_int(
+		props, PROP_IDLE_WAIT,
+		obs_module_text("NDIPlugin.SourceProps.IdleWait"), 100, 5000,
+		100);
+	obs_property_int_set_suffix(idle_wait, " ms");
+	obs_property_set_long_description(
+		idle_wait,
+		obs_module_text("NDIPlugin.SourceProps.IdleWait.Help"));
+
+	obs_property_t *thread_cpus = obs_properties_add_text(
+		props, PROP_THREAD_CPUS,
+		obs_module_text("NDIPlugin.SourceProps.ThreadCpus"),
+		OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(
+		thread_cpus,
+		obs_module_text("NDIPlugin.SourceProps.ThreadCpus.Help"));
+
+	obs_property_t *thread_priorities = obs_properties_add_list(
+		props, PROP_THREAD_PRIORITY,
+		obs_module_text("NDIPlugin.SourceProps.ThreadPriority"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(
+		thread_priorities,
+		obs_module_text("NDIPlugin.ThreadPriority.Default"),
+		NDI_THREAD_PRIORITY_DEFAULT);
+	obs_property_list_add_int(
+		thread_priorities,
+		obs_module_text("NDIPlugin.ThreadPriority.Normal"),
+		NDI_THREAD_PRIORITY_NORMAL);
+	obs_property_list_add_int(
+		thread_priorities,
+		obs_module_text("NDIPlugin.ThreadPriority.High"),
+		NDI_THREAD_PRIORITY_HIGH);
+	obs_property_list_add_int(
+		thread_priorities,
+		obs_module_text("NDIPlugin.ThreadPriority.Realtime"),
+		NDI_THREAD_PRIORITY_REALTIME);
+
 	obs_properties_add_button(props, "ndi_website", "NDI.NewTek.com",
 				  [](obs_properties_t *pps,
 				     obs_property_t *prop, void *private_data) {
@@ -310,163 +688,1039 @@ void ndi_source_getdefaults(obs_data_t *settings)
 				 PROP_YUV_SPACE_BT709);
 	obs_data_set_default_int(settings, PROP_LATENCY, PROP_LATENCY_NORMAL);
 	obs_data_set_default_bool(settings, PROP_AUDIO, true);
+	obs_data_set_default_int(settings, PROP_IDLE_WAIT, 1000);
+	obs_data_set_default_int(settings, PROP_MAX_QUEUE, 0);
+	obs_data_set_default_int(settings, PROP_COLOR_FORMAT,
+				 PROP_COLOR_FORMAT_UYVY_BGRA);
+	obs_data_set_default_int(settings, PROP_DEINTERLACE,
+				 NDI_DEINTERLACE_OFF);
+	obs_data_set_default_bool(settings, PROP_CLOCK_RECOVERY, true);
+	obs_data_set_default_bool(settings, PROP_AUDIO_RESAMPLE, false);
+	obs_data_set_default_int(settings, PROP_THREAD_PRIORITY,
+				 NDI_THREAD_PRIORITY_DEFAULT);
+	obs_data_set_default_int(settings, PROP_SYNC_DELIVERY,
+				 PROP_SYNC_DELIVERY_FRAMESYNC);
+	obs_data_set_default_string(settings, PROP_BACKUP_SOURCE, "");
+	obs_data_set_default_int(settings, PROP_FAILOVER_TIMEOUT, 250);
+	obs_data_set_default_int(settings, PROP_CROP_LEFT, 0);
+	obs_data_set_default_int(settings, PROP_CROP_TOP, 0);
+	obs_data_set_default_int(settings, PROP_CROP_RIGHT, 0);
+	obs_data_set_default_int(settings, PROP_CROP_BOTTOM, 0);
+	obs_data_set_default_int(settings, PROP_TARGET_WIDTH, 0);
+	obs_data_set_default_int(settings, PROP_TARGET_HEIGHT, 0);
 }
 
-void *ndi_source_poll_audio_video(void *data)
+static struct ndi_pooled_frame *
+ndi_source_get_conv_frame(struct ndi_source *s,
+			  const struct ndi_frame_layout *layout)
 {
-	auto s = (struct ndi_source *)data;
+	ndi_frame_pool_put(s->frame_pool, s->conv_frame);
+	s->conv_frame = ndi_frame_pool_get(s->frame_pool, layout);
+	return s->conv_frame;
+}
 
-	blog(LOG_INFO, "A/V thread for '%s' started",
-	     obs_source_get_name(s->source));
+// Once libobs has copied the frame
+static void ndi_source_put_conv_frame(struct ndi_source *s)
+{
+	ndi_frame_pool_put(s->frame_pool, s->conv_frame);
+	s->conv_frame = nullptr;
+}
 
-	NDIlib_audio_frame_v3_t audio_frame;
-	obs_source_audio obs_audio_frame = {};
-	NDIlib_video_frame_v2_t video_frame;
+// 16-bit 4:2:2 frames (P216, or PA16 whose trailing alpha plane libobs
+// can't use). Recent libobs takes P216 as-is; older versions with 10-bit
+// support get P010, repacked on the receive thread.
+static bool ndi_source_fill_p216_frame(struct ndi_source *s,
+				       const NDIlib_video_frame_v2_t *video_frame,
+				       obs_source_frame *obs_video_frame)
+{
+	const uint32_t stride = (uint32_t)video_frame->line_stride_in_bytes;
+	uint8_t *uv_plane = video_frame->p_data + stride * video_frame->yres;
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(29, 1, 0)
+	UNUSED_PARAMETER(s);
+	obs_video_frame->format = VIDEO_FORMAT_P216;
+	obs_video_frame->data[1] = uv_plane;
+	obs_video_frame->linesize[1] = stride;
+	return true;
+#elif LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+	// Only the UV plane is rebuilt, luma is used in place
+	const struct ndi_frame_layout layout = {
+		1, {stride}, {(uint32_t)(video_frame->yres + 1) / 2}};
+	struct ndi_pooled_frame *p010_uv =
+		ndi_source_get_conv_frame(s, &layout);
+
+	ndi_convert_p216_uv_to_p010(uv_plane, stride, p010_uv->data[0],
+				    p010_uv->linesize[0], video_frame->xres,
+				    video_frame->yres);
+
+	obs_video_frame->format = VIDEO_FORMAT_P010;
+	obs_video_frame->data[1] = p010_uv->data[0];
+	obs_video_frame->linesize[1] = p010_uv->linesize[0];
+	return true;
+#else
+	UNUSED_PARAMETER(s);
+	UNUSED_PARAMETER(uv_plane);
+	return false;
+#endif
+}
+
+// UYVA is a UYVY plane followed by a full resolution 8-bit alpha plane.
+// The UYVY part is split into the I422 planes of a pooled frame and the
+// alpha plane is passed through, which keeps alpha at 3 bytes per pixel
+// instead of the 4 of BGRA.
+static void ndi_source_fill_uyva_frame(struct ndi_source *s,
+				       const NDIlib_video_frame_v2_t *video_frame,
+				       obs_source_frame *obs_video_frame)
+{
+	const uint32_t stride = (uint32_t)video_frame->line_stride_in_bytes;
+	const uint32_t width = (uint32_t)video_frame->xres;
+	const uint32_t height = (uint32_t)video_frame->yres;
+
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(26, 1, 0)
+	struct ndi_frame_layout layout;
+	ndi_frame_layout_for_format(&layout, VIDEO_FORMAT_I422, width, height);
+	struct ndi_pooled_frame *i422 = ndi_source_get_conv_frame(s, &layout);
+
+	ndi_convert_uyvy_to_i422(video_frame->p_data, stride, i422->data,
+				 i422->linesize, width, height);
+
+	obs_video_frame->format = VIDEO_FORMAT_I42A;
+	for (size_t i = 0; i < 3; ++i) {
+		obs_video_frame->data[i] = i422->data[i];
+		obs_video_frame->linesize[i] = i422->linesize[i];
+	}
+	obs_video_frame->data[3] = video_frame->p_data + stride * height;
+	obs_video_frame->linesize[3] = width;
+#else
+	// No planar alpha formats, alpha is dropped
+	UNUSED_PARAMETER(s);
+	UNUSED_PARAMETER(stride);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	obs_video_frame->format = VIDEO_FORMAT_UYVY;
+#endif
+}
+
+static bool ndi_source_fill_video_frame(struct ndi_source *s,
+					const NDIlib_video_frame_v2_t *video_frame,
+					obs_source_frame *obs_video_frame)
+{
+	const uint32_t stride = (uint32_t)video_frame->line_stride_in_bytes;
+
+	memset(obs_video_frame->data, 0, sizeof(obs_video_frame->data));
+	memset(obs_video_frame->linesize, 0,
+	       sizeof(obs_video_frame->linesize));
+
+	obs_video_frame->data[0] = video_frame->p_data;
+	obs_video_frame->linesize[0] = stride;
+
+	switch (video_frame->FourCC) {
+	case NDIlib_FourCC_type_BGRA:
+		obs_video_frame->format = VIDEO_FORMAT_BGRA;
+		break;
+
+	case NDIlib_FourCC_type_BGRX:
+		obs_video_frame->format = VIDEO_FORMAT_BGRX;
+		break;
+
+	case NDIlib_FourCC_type_RGBA:
+	case NDIlib_FourCC_type_RGBX:
+		obs_video_frame->format = VIDEO_FORMAT_RGBA;
+		break;
+
+	case NDIlib_FourCC_type_UYVY:
+		obs_video_frame->format = VIDEO_FORMAT_UYVY;
+		break;
+
+	case NDIlib_FourCC_type_UYVA:
+		ndi_source_fill_uyva_frame(s, video_frame, obs_video_frame);
+		break;
+
+	case NDIlib_FourCC_type_I420:
+		obs_video_frame->format = VIDEO_FORMAT_I420;
+		obs_video_frame->data[1] =
+			video_frame->p_data + stride * video_frame->yres;
+		obs_video_frame->linesize[1] = stride / 2;
+		obs_video_frame->data[2] =
+			obs_video_frame->data[1] +
+			(stride / 2) * ((video_frame->yres + 1) / 2);
+		obs_video_frame->linesize[2] = stride / 2;
+		break;
+
+	case NDIlib_FourCC_type_NV12:
+		obs_video_frame->format = VIDEO_FORMAT_NV12;
+		obs_video_frame->data[1] =
+			video_frame->p_data + stride * video_frame->yres;
+		obs_video_frame->linesize[1] = stride;
+		break;
+
+	case NDIlib_FourCC_type_P216:
+	case NDIlib_FourCC_type_PA16:
+		if (ndi_source_fill_p216_frame(s, video_frame,
+					       obs_video_frame))
+			break;
+		// fallthrough
+
+	default:
+		blog(LOG_INFO, "warning: unsupported video pixel format: %d",
+		     video_frame->FourCC);
+		return false;
+	}
+
+	obs_video_frame->width = video_frame->xres;
+	obs_video_frame->height = video_frame->yres;
+
+	const video_colorspace colorspace = s->yuv_colorspace;
+	const video_range_type range = s->yuv_range;
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+	video_format_get_parameters_for_format(
+		colorspace, range, obs_video_frame->format,
+		obs_video_frame->color_matrix, obs_video_frame->color_range_min,
+		obs_video_frame->color_range_max);
+#else
+	video_format_get_parameters(colorspace, range,
+				    obs_video_frame->color_matrix,
+				    obs_video_frame->color_range_min,
+				    obs_video_frame->color_range_max);
+#endif
+	obs_video_frame->full_range = (range == VIDEO_RANGE_FULL);
+	return true;
+}
+
+// Crop, then downscale what's left. The crop only moves plane pointers.
+static void ndi_source_shape_video(struct ndi_source *s,
+				   obs_source_frame *frame)
+{
+	ndi_frame_crop(frame, s->crop_left, s->crop_top, s->crop_right,
+		       s->crop_bottom);
+	ndi_scaler_shrink(s->scaler, frame, s->target_width,
+			  s->target_height);
+}
+
+static void ndi_source_ring_clear(struct ndi_source *s)
+{
+	pthread_mutex_lock(&s->ring_mutex);
+	for (size_t i = 0; i < s->ring_count; ++i)
+		ndi_frame_pool_put(s->ring_pool, s->ring[i].frame);
+	s->ring_count = 0;
+	pthread_mutex_unlock(&s->ring_mutex);
+}
+
+// Receive ring mode, on the video thread: copies the frame into the ring,
+// evicting the oldest one when it's full
+static void ndi_source_ring_push(struct ndi_source *s,
+				 const struct obs_source_frame *frame)
+{
+	struct ndi_frame_layout layout;
+	if (!ndi_frame_layout_for_format(&layout, frame->format, frame->width,
+					 frame->height)) {
+		ndi_stats_add(s->stats.video_discarded);
+		return;
+	}
+
+	struct ndi_ring_entry entry = {};
+	entry.frame = ndi_frame_pool_get(s->ring_pool, &layout);
+	entry.info = *frame;
+	for (uint32_t i = 0; i < layout.plane_count; ++i) {
+		for (uint32_t y = 0; y < layout.rows[i]; ++y)
+			memcpy(entry.frame->data[i] +
+				       (size_t)y * entry.frame->linesize[i],
+			       frame->data[i] + (size_t)y * frame->linesize[i],
+			       layout.row_bytes[i]);
+		entry.info.data[i] = entry.frame->data[i];
+		entry.info.linesize[i] = entry.frame->linesize[i];
+	}
+
+	struct ndi_pooled_frame *evicted = nullptr;
+	pthread_mutex_lock(&s->ring_mutex);
+	if (s->ring_count == SYNC_RING_SIZE) {
+		evicted = s->ring[0].frame;
+		memmove(&s->ring[0], &s->ring[1],
+			(SYNC_RING_SIZE - 1) * sizeof(s->ring[0]));
+		s->ring_count--;
+	}
+	s->ring[s->ring_count++] = entry;
+	pthread_mutex_unlock(&s->ring_mutex);
+
+	if (evicted) {
+		ndi_frame_pool_put(s->ring_pool, evicted);
+		ndi_stats_add(s->stats.video_discarded);
+	}
+}
+
+// Receive ring mode, on the graphics thread: once per OBS frame, uploads
+// the newest frame whose timestamp is due and drops the older ones. A
+// frame arriving early stays in the ring for the next OBS frame.
+static void ndi_source_ring_upload(struct ndi_source *s)
+{
+	const uint64_t frame_time = obs_get_video_frame_time();
+	if (frame_time == s->ring_render_time)
+		return;
+	s->ring_render_time = frame_time;
+
+	struct ndi_pooled_frame *skipped[SYNC_RING_SIZE];
+	size_t skipped_count = 0;
+	struct ndi_ring_entry due = {};
+
+	pthread_mutex_lock(&s->ring_mutex);
+	size_t count = 0;
+	while (count < s->ring_count &&
+	       s->ring[count].info.timestamp <= frame_time)
+		count++;
+	if (count) {
+		for (size_t i = 0; i + 1 < count; ++i)
+			skipped[skipped_count++] = s->ring[i].frame;
+		due = s->ring[count - 1];
+		s->ring_count -= count;
+		memmove(&s->ring[0], &s->ring[count],
+			s->ring_count * sizeof(s->ring[0]));
+	}
+	pthread_mutex_unlock(&s->ring_mutex);
+
+	for (size_t i = 0; i < skipped_count; ++i) {
+		ndi_frame_pool_put(s->ring_pool, skipped[i]);
+		ndi_stats_add(s->stats.video_discarded);
+	}
+
+	if (due.frame) {
+		frame_render_upload(s->render, &due.info);
+		ndi_frame_pool_put(s->ring_pool, due.frame);
+	}
+}
+
+// Sender time of a frame in ns, following the source's sync mode
+static int64_t ndi_source_sender_time(const struct ndi_source *s,
+				      int64_t timestamp, int64_t timecode)
+{
+	return (s->sync_mode == PROP_SYNC_NDI_SOURCE_TIMECODE ? timecode
+							       : timestamp) *
+	       100;
+}
+
+static void ndi_source_output_video(void *data,
+				    const NDIlib_video_frame_v2_t *video_frame)
+{
+	auto s = (struct ndi_source *)data;
 	obs_source_frame obs_video_frame = {};
 
-	if (s->perf_token) {
-		os_end_high_performance(s->perf_token);
+	if (!ndi_source_fill_video_frame(s, video_frame, &obs_video_frame)) {
+		ndi_source_put_conv_frame(s);
+		ndi_stats_add(s->stats.video_discarded);
+		return;
 	}
-	s->perf_token = os_request_high_performance("NDI Receiver Thread");
 
-	NDIlib_frame_type_e frame_received = NDIlib_frame_type_none;
-	while (s->running) {
-		if (ndiLib->recv_get_no_connections(s->ndi_receiver) == 0) {
-			std::this_thread::sleep_for(
-				std::chrono::milliseconds(100));
-			continue;
+	const int64_t sender_time = ndi_source_sender_time(
+		s, video_frame->timestamp, video_frame->timecode);
+	obs_video_frame.timestamp =
+		s->clock_recovery ? ndi_clock_map(&s->clock, sender_time,
+						  s->video_arrival_ns)
+				  : (uint64_t)sender_time;
+
+	ndi_source_shape_video(s, &obs_video_frame);
+
+	// Sync sources only get pushed frames in receive ring mode
+	if (s->is_sync)
+		ndi_source_ring_push(s, &obs_video_frame);
+	else
+		obs_source_output_video(s->source, &obs_video_frame);
+	ndi_scaler_release(s->scaler);
+	ndi_source_put_conv_frame(s);
+
+	ndi_stats_add(s->stats.video_frames);
+	ndi_stats_add_latency(&s->stats, os_gettime_ns() - s->video_capture_ns);
+}
+
+// Called from the shared receiver's video thread
+static void ndi_source_receive_video(void *data, struct ndi_receiver *r,
+				     const NDIlib_video_frame_v2_t *video_frame)
+{
+	auto s = (struct ndi_source *)data;
+
+	pthread_mutex_lock(&s->video_mutex);
+
+	// A pre-warmed receiver takes over with its first frame, the
+	// active one is ignored from then on until the switch completes
+	if (r == s->pending_receiver) {
+		s->pending_ready = true;
+	} else if (r != s->receiver || s->pending_ready) {
+		pthread_mutex_unlock(&s->video_mutex);
+		return;
+	}
+
+	const uint64_t start = os_gettime_ns();
+	s->video_arrival_ns = start;
+	s->video_capture_ns = ndi_receiver_get_capture_time(r);
+	s->last_video_ns = start;
+	if (s->clock_recovery)
+		ndi_clock_update(&s->clock,
+				 ndi_source_sender_time(s,
+							video_frame->timestamp,
+							video_frame->timecode),
+				 start);
+
+	ndi_deinterlacer_process(s->deinterlacer, s->deinterlace_mode,
+				 video_frame, ndi_source_output_video, s);
+	ndi_stats_add_convert(&s->stats, os_gettime_ns() - start);
+
+	pthread_mutex_unlock(&s->video_mutex);
+}
+
+static float *ndi_source_audio_buffer(struct ndi_source *s, size_t frames)
+{
+	if (frames > s->audio_buffer_frames) {
+		bfree(s->audio_buffer);
+		s->audio_buffer = (float *)bmalloc(
+			frames * NDI_AUDIO_MATRIX_MAX_OUTPUTS * sizeof(float));
+		s->audio_buffer_frames = frames;
+	}
+	return s->audio_buffer;
+}
+
+// Fills the planes and layout of an OBS audio frame: the first 8 NDI
+// channels as-is, or the output of the channel matrix when one is set
+static void ndi_source_map_audio(struct ndi_source *s,
+				 const NDIlib_audio_frame_v3_t *audio_frame,
+				 obs_source_audio *obs_audio_frame)
+{
+	const struct ndi_audio_matrix *m = &s->audio_matrix;
+
+	if (!m->output_count) {
+		const int channelCount = audio_frame->no_channels > 8
+						 ? 8
+						 : audio_frame->no_channels;
+
+		if (audio_frame->no_channels > 8 && !s->audio_clamp_warned) {
+			blog(LOG_WARNING,
+			     "NDI source '%s' has %d audio channels, only "
+			     "the first 8 are used without a channel matrix",
+			     obs_source_get_name(s->source),
+			     audio_frame->no_channels);
+			s->audio_clamp_warned = true;
 		}
 
-		frame_received =
-			ndiLib->recv_capture_v3(s->ndi_receiver, &video_frame,
-						&audio_frame, nullptr, 100);
-
-		if (frame_received == NDIlib_frame_type_audio) {
-			if (s->audio_enabled) {
-				const int channelCount =
-					audio_frame.no_channels > 8
-						? 8
-						: audio_frame.no_channels;
-
-				obs_audio_frame.speakers =
-					channel_count_to_layout(channelCount);
-
-				switch (s->sync_mode) {
-				case PROP_SYNC_NDI_TIMESTAMP:
-					obs_audio_frame.timestamp =
-						(uint64_t)(audio_frame.timestamp *
-							   100);
-					break;
-
-				case PROP_SYNC_NDI_SOURCE_TIMECODE:
-					obs_audio_frame.timestamp =
-						(uint64_t)(audio_frame.timecode *
-							   100);
-					break;
-				}
-
-				obs_audio_frame.samples_per_sec =
-					audio_frame.sample_rate;
-				obs_audio_frame.format =
-					AUDIO_FORMAT_FLOAT_PLANAR;
-				obs_audio_frame.frames = audio_frame.no_samples;
-
-				for (int i = 0; i < channelCount; ++i) {
-					obs_audio_frame.data[i] =
-						(uint8_t *)audio_frame.p_data +
-						i * audio_frame.channel_stride_in_bytes;
-				}
-
-				obs_source_output_audio(s->source,
-							&obs_audio_frame);
-			}
-			ndiLib->recv_free_audio_v3(s->ndi_receiver,
-						   &audio_frame);
+		obs_audio_frame->speakers =
+			channel_count_to_layout(channelCount);
+		for (int i = 0; i < channelCount; ++i) {
+			obs_audio_frame->data[i] =
+				(uint8_t *)audio_frame->p_data +
+				i * audio_frame->channel_stride_in_bytes;
 		}
 
-		if (frame_received == NDIlib_frame_type_video) {
-			switch (video_frame.FourCC) {
-			case NDIlib_FourCC_type_BGRA:
-				obs_video_frame.format = VIDEO_FORMAT_BGRA;
-				break;
-
-			case NDIlib_FourCC_type_BGRX:
-				obs_video_frame.format = VIDEO_FORMAT_BGRX;
-				break;
-
-			case NDIlib_FourCC_type_RGBA:
-			case NDIlib_FourCC_type_RGBX:
-				obs_video_frame.format = VIDEO_FORMAT_RGBA;
-				break;
-
-			case NDIlib_FourCC_type_UYVY:
-			case NDIlib_FourCC_type_UYVA:
-				obs_video_frame.format = VIDEO_FORMAT_UYVY;
-				break;
-
-			case NDIlib_FourCC_type_I420:
-				obs_video_frame.format = VIDEO_FORMAT_I420;
-				break;
-
-			case NDIlib_FourCC_type_NV12:
-				obs_video_frame.format = VIDEO_FORMAT_NV12;
-				break;
-
-			default:
-				blog(LOG_INFO,
-				     "warning: unsupported video pixel format: %d",
-				     video_frame.FourCC);
-				break;
-			}
+		// OBS has no 7 channel layout, send 7.1 with a silent last
+		// channel instead
+		if (channelCount == 7) {
+			const size_t frames = (size_t)audio_frame->no_samples;
+			float *silence = ndi_source_audio_buffer(s, frames);
+			memset(silence, 0, frames * sizeof(float));
+			obs_audio_frame->data[7] = (uint8_t *)silence;
+			obs_audio_frame->speakers = SPEAKERS_7POINT1;
+		}
+		return;
+	}
 
-			switch (s->sync_mode) {
-			case PROP_SYNC_NDI_TIMESTAMP:
-				obs_video_frame.timestamp =
-					(uint64_t)(video_frame.timestamp * 100);
-				break;
+	ndi_source_audio_buffer(s, (size_t)audio_frame->no_samples);
 
-			case PROP_SYNC_NDI_SOURCE_TIMECODE:
-				obs_video_frame.timestamp =
-					(uint64_t)(video_frame.timecode * 100);
-				break;
-			}
+	float *planes[NDI_AUDIO_MATRIX_MAX_OUTPUTS];
+	for (size_t i = 0; i < m->output_count; ++i) {
+		planes[i] = s->audio_buffer + i * s->audio_buffer_frames;
+		obs_audio_frame->data[i] = (uint8_t *)planes[i];
+	}
+
+	ndi_audio_matrix_apply(m, audio_frame->p_data,
+			       (uint32_t)audio_frame->channel_stride_in_bytes,
+			       audio_frame->no_channels,
+			       (uint32_t)audio_frame->no_samples, planes);
 
-			obs_video_frame.width = video_frame.xres;
-			obs_video_frame.height = video_frame.yres;
-			obs_video_frame.linesize[0] =
-				video_frame.line_stride_in_bytes;
-			obs_video_frame.data[0] = video_frame.p_data;
-
-			video_format_get_parameters(
-				s->yuv_colorspace, s->yuv_range,
-				obs_video_frame.color_matrix,
-				obs_video_frame.color_range_min,
-				obs_video_frame.color_range_max);
-
-			obs_source_output_video(s->source, &obs_video_frame);
-			ndiLib->recv_free_video_v2(s->ndi_receiver,
-						   &video_frame);
+	obs_audio_frame->speakers =
+		channel_count_to_layout((int)m->output_count);
+}
+
+static void ndi_source_resample_audio(struct ndi_source *s,
+				      obs_source_audio *obs_audio_frame)
+{
+	struct obs_audio_info oai;
+	if (!obs_get_audio_info(&oai) ||
+	    oai.samples_per_sec == obs_audio_frame->samples_per_sec)
+		return;
+
+	if (!s->resampler ||
+	    s->resample_src.samples_per_sec !=
+		    obs_audio_frame->samples_per_sec ||
+	    s->resample_src.speakers != obs_audio_frame->speakers ||
+	    s->resample_dst_rate != oai.samples_per_sec) {
+		audio_resampler_destroy(s->resampler);
+
+		// Channels are left to OBS, only the rate changes here
+		s->resample_src.samples_per_sec =
+			obs_audio_frame->samples_per_sec;
+		s->resample_src.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		s->resample_src.speakers = obs_audio_frame->speakers;
+		s->resample_dst_rate = oai.samples_per_sec;
+
+		struct resample_info dst = s->resample_src;
+		dst.samples_per_sec = oai.samples_per_sec;
+		s->resampler = audio_resampler_create(&dst, &s->resample_src);
+		if (!s->resampler) {
+			blog(LOG_WARNING,
+			     "can't resample NDI audio from %u to %u Hz",
+			     obs_audio_frame->samples_per_sec,
+			     oai.samples_per_sec);
+			return;
 		}
 	}
 
-	os_end_high_performance(s->perf_token);
-	s->perf_token = NULL;
+	uint8_t *output[MAX_AV_PLANES] = {};
+	uint32_t out_frames = 0;
+	uint64_t ts_offset = 0;
+	if (!audio_resampler_resample(s->resampler, output, &out_frames,
+				      &ts_offset, obs_audio_frame->data,
+				      obs_audio_frame->frames))
+		return;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; ++i)
+		obs_audio_frame->data[i] = output[i];
+	obs_audio_frame->frames = out_frames;
+	obs_audio_frame->samples_per_sec = oai.samples_per_sec;
+	obs_audio_frame->timestamp -= ts_offset;
+}
 
-	blog(LOG_INFO, "audio thread for '%s' completed",
-	     obs_source_get_name(s->source));
-	return nullptr;
+static void ndi_source_output_audio(struct ndi_source *s,
+				    const NDIlib_audio_frame_v3_t *audio_frame)
+{
+	obs_source_audio obs_audio_frame = {};
+	ndi_source_map_audio(s, audio_frame, &obs_audio_frame);
+
+	const int64_t sender_time = ndi_source_sender_time(
+		s, audio_frame->timestamp, audio_frame->timecode);
+	obs_audio_frame.timestamp =
+		s->clock_recovery ? ndi_clock_update(&s->clock, sender_time,
+						     os_gettime_ns())
+				  : (uint64_t)sender_time;
+
+	obs_audio_frame.samples_per_sec = audio_frame->sample_rate;
+	obs_audio_frame.format = AUDIO_FORMAT_FLOAT_PLANAR;
+	obs_audio_frame.frames = audio_frame->no_samples;
+
+	if (s->audio_resample)
+		ndi_source_resample_audio(s, &obs_audio_frame);
+
+	obs_source_output_audio(s->source, &obs_audio_frame);
+	ndi_stats_add(s->stats.audio_frames);
 }
 
-void ndi_source_update(void *data, obs_data_t *settings)
+// Called from the shared receiver's audio thread
+static void ndi_source_receive_audio(void *data, struct ndi_receiver *r,
+				     const NDIlib_audio_frame_v3_t *audio_frame)
+{
+	auto s = (struct ndi_source *)data;
+
+	if (!s->audio_enabled)
+		return;
+
+	pthread_mutex_lock(&s->audio_mutex);
+
+	// Audio follows video to the pre-warmed receiver
+	const bool use = (r == s->pending_receiver)
+				 ? s->pending_ready
+				 : (r == s->receiver && !s->pending_ready);
+	if (use)
+		ndi_source_output_audio(s, audio_frame);
+
+	pthread_mutex_unlock(&s->audio_mutex);
+}
+
+static void ndi_source_set_receiver_tally(struct ndi_source *s)
+{
+	if (s->receiver)
+		ndi_receiver_set_tally(s->receiver, s, s->on_preview,
+				       s->on_program);
+	if (s->pending_receiver)
+		ndi_receiver_set_tally(s->pending_receiver, s, s->on_preview,
+				       s->on_program);
+}
+
+static void ndi_source_set_pending(struct ndi_source *s,
+				   struct ndi_receiver *pending)
+{
+	pthread_mutex_lock(&s->video_mutex);
+	pthread_mutex_lock(&s->audio_mutex);
+	s->pending_receiver = pending;
+	s->pending_ready = false;
+	pthread_mutex_unlock(&s->audio_mutex);
+	pthread_mutex_unlock(&s->video_mutex);
+}
+
+static void ndi_source_cancel_pending(struct ndi_source *s)
+{
+	struct ndi_receiver *pending = s->pending_receiver;
+	s->pending_rebuild = false;
+	if (!pending)
+		return;
+
+	ndi_receiver_disconnect(pending, s);
+	ndi_source_set_pending(s, nullptr);
+	ndi_receiver_release(pending);
+}
+
+// Connects a receiver next to the active one, it takes over once it
+// delivers video (see ndi_source_promote_pending)
+static void ndi_source_prewarm(struct ndi_source *s,
+			       struct ndi_receiver *pending)
+{
+	ndi_source_set_pending(s, pending);
+	s->pending_since = os_gettime_ns();
+	ndi_receiver_connect(pending, s, ndi_source_receive_video,
+			     ndi_source_receive_audio);
+	ndi_receiver_set_tally(pending, s, s->on_preview, s->on_program);
+}
+
+static bool ndi_source_pending_done(struct ndi_source *s)
+{
+	pthread_mutex_lock(&s->video_mutex);
+	const bool ready = s->pending_ready;
+	pthread_mutex_unlock(&s->video_mutex);
+
+	// A receiver that failed to connect won't ever get ready
+	return ready ||
+	       ndi_receiver_get_state(s->pending_receiver) ==
+		       NDI_RECEIVER_FAILED ||
+	       os_gettime_ns() - s->pending_since >= PREWARM_TIMEOUT_NS;
+}
+
+// Loss detection restarts with every change of active receiver
+static void ndi_source_reset_activity(struct ndi_source *s)
+{
+	s->active_since = os_gettime_ns();
+	s->last_video_ns = 0;
+}
+
+static void ndi_source_promote_pending(struct ndi_source *s)
+{
+	struct ndi_receiver *previous = s->receiver;
+
+	// Frames of the pending receiver keep flowing during the swap
+	if (previous)
+		ndi_receiver_disconnect(previous, s);
+
+	pthread_mutex_lock(&s->video_mutex);
+	pthread_mutex_lock(&s->audio_mutex);
+	s->receiver = s->pending_receiver;
+	s->pending_receiver = nullptr;
+	s->pending_ready = false;
+	pthread_mutex_unlock(&s->audio_mutex);
+	pthread_mutex_unlock(&s->video_mutex);
+
+	ndi_receiver_release(previous);
+	ndi_source_reset_activity(s);
+}
+
+// Highest bandwidth while shown or on program, lowest once hidden for
+// BW_AUTO_HOLD_NS. The receiver for the new bandwidth is connected ahead
+// of time and only replaces the active one once it delivers video.
+static void ndi_source_auto_bandwidth(struct ndi_source *s)
 {
+	const uint64_t now = os_gettime_ns();
+	NDIlib_recv_bandwidth_e target = s->recv_desc.bandwidth;
+
+	if (s->on_preview || s->on_program) {
+		s->bw_hidden_since = 0;
+		target = NDIlib_recv_bandwidth_highest;
+	} else if (!s->bw_hidden_since) {
+		s->bw_hidden_since = now;
+	} else if (now - s->bw_hidden_since >= BW_AUTO_HOLD_NS) {
+		target = NDIlib_recv_bandwidth_lowest;
+	}
+
+	if (s->pending_receiver) {
+		// The pre-warmed receiver is at the other bandwidth
+		if (target == s->recv_desc.bandwidth) {
+			ndi_source_cancel_pending(s);
+			return;
+		}
+
+		if (ndi_source_pending_done(s)) {
+			ndi_source_promote_pending(s);
+			s->recv_desc.bandwidth = target;
+
+			blog(LOG_INFO,
+			     "NDI source '%s' switched to %s bandwidth",
+			     s->ndi_name,
+			     target == NDIlib_recv_bandwidth_highest
+				     ? "highest"
+				     : "lowest");
+		}
+		return;
+	}
+
+	if (target != s->recv_desc.bandwidth) {
+		struct ndi_receiver_desc desc = s->recv_desc;
+		desc.bandwidth = target;
+
+		struct ndi_receiver *pending = ndi_receiver_acquire(&desc);
+		if (pending)
+			ndi_source_prewarm(s, pending);
+	}
+}
+
+// Emits "ndi_metadata" for the frames 'r' received since the last tick.
+// Runs on the graphics thread, never on the receiver's capture threads.
+static void ndi_source_signal_metadata(struct ndi_source *s,
+				       struct ndi_receiver *r)
+{
+	const uint64_t count = ndi_receiver_metadata_count(r);
+
+	// Only frames arriving after a receiver switch are signaled
+	if (r != s->metadata_receiver) {
+		s->metadata_receiver = r;
+		s->metadata_next = count;
+		return;
+	}
+
+	if (s->metadata_next == count)
+		return;
+	if (count - s->metadata_next > NDI_METADATA_RING_SIZE)
+		s->metadata_next = count - NDI_METADATA_RING_SIZE;
+
+	auto frame = (struct ndi_metadata_frame *)bmalloc(
+		sizeof(struct ndi_metadata_frame));
+	signal_handler_t *sh = obs_source_get_signal_handler(s->source);
+	calldata_t cd;
+	calldata_init(&cd);
+
+	for (; s->metadata_next < count; ++s->metadata_next) {
+		if (!ndi_receiver_read_metadata(r, s->metadata_next, frame))
+			continue;
+
+		calldata_set_ptr(&cd, "source", s->source);
+		calldata_set_string(&cd, "metadata", frame->data);
+		calldata_set_int(&cd, "timecode", frame->timecode);
+		signal_handler_signal(sh, "ndi_metadata", &cd);
+	}
+
+	calldata_free(&cd);
+	bfree(frame);
+}
+
+// Connects the warm standby for 'name', or drops it when empty
+static void ndi_source_set_standby(struct ndi_source *s, const char *name)
+{
+	struct ndi_receiver *previous = s->standby_receiver;
+	s->standby_receiver = nullptr;
+	bfree(s->backup_name);
+	s->backup_name = (name && *name) ? bstrdup(name) : nullptr;
+
+	// Acquired before the previous one is released, so that an
+	// unchanged standby is picked up again from the pool
+	if (s->backup_name && s->ndi_name &&
+	    strcmp(s->backup_name, s->ndi_name) != 0) {
+		struct ndi_receiver_desc desc = s->recv_desc;
+		desc.ndi_name = s->backup_name;
+		desc.bandwidth = NDIlib_recv_bandwidth_lowest;
+		s->standby_receiver = ndi_receiver_acquire(&desc);
+	}
+
+	ndi_receiver_release(previous);
+}
+
+// Without a video frame for the failover timeout, or once the sender
+// dropped the connection after having delivered video. Until its first
+// frame, the active receiver has FAILOVER_CONNECT_GRACE_NS from its
+// creation instead: a slow connect is not a lost sender.
+static bool ndi_source_active_lost(struct ndi_source *s)
+{
+	const enum ndi_receiver_state state =
+		ndi_receiver_get_state(s->receiver);
+	if (state == NDI_RECEIVER_FAILED)
+		return true;
+
+	const uint64_t now = os_gettime_ns();
+	if (state == NDI_RECEIVER_CONNECTING) {
+		s->active_since = now;
+		return false;
+	}
+
+	const uint64_t last = s->last_video_ns;
+	if (!last) {
+		const uint64_t grace =
+			s->failover_timeout_ns > FAILOVER_CONNECT_GRACE_NS
+				? s->failover_timeout_ns
+				: FAILOVER_CONNECT_GRACE_NS;
+		return now - s->active_since >= grace;
+	}
+
+	if (now > last && now - last >= s->failover_timeout_ns)
+		return true;
+
+	NDIlib_recv_instance_t instance = ndi_receiver_get_instance(s->receiver);
+	return last && instance &&
+	       ndiLib->recv_get_no_connections(instance) == 0;
+}
+
+// The standby shows its lowest bandwidth frames from its next one on,
+// and the next ticks move it back to the source's bandwidth. The lost
+// sender becomes the standby, so that losing the backup later fails back
+// once the lost one is connected again.
+static void ndi_source_failover(struct ndi_source *s)
+{
+	struct ndi_receiver *standby = s->standby_receiver;
+	NDIlib_recv_instance_t instance = ndi_receiver_get_instance(standby);
+	if (!instance || ndiLib->recv_get_no_connections(instance) == 0)
+		return;
+
+	ndi_source_cancel_pending(s);
+
+	struct ndi_receiver *lost = s->receiver;
+	ndi_receiver_disconnect(lost, s);
+
+	pthread_mutex_lock(&s->video_mutex);
+	pthread_mutex_lock(&s->audio_mutex);
+	s->receiver = standby;
+	s->standby_receiver = nullptr;
+	pthread_mutex_unlock(&s->audio_mutex);
+	pthread_mutex_unlock(&s->video_mutex);
+
+	ndi_receiver_connect(standby, s, ndi_source_receive_video,
+			     ndi_source_receive_audio);
+	ndi_receiver_set_tally(standby, s, s->on_preview, s->on_program);
+	ndi_receiver_release(lost);
+	ndi_clock_reset(&s->clock);
+	ndi_source_reset_activity(s);
+
+	char *lost_name = s->ndi_name;
+	s->ndi_name = s->backup_name;
+	s->backup_name = lost_name;
+	s->failed_over = !s->failed_over;
+
+	s->recv_desc.ndi_name = s->ndi_name;
+	s->recv_desc.bandwidth = NDIlib_recv_bandwidth_lowest;
+
+	blog(LOG_WARNING, "NDI source '%s' lost '%s', failed over to '%s'",
+	     obs_source_get_name(s->source), lost_name, s->ndi_name);
+
+	struct ndi_receiver_desc desc = s->recv_desc;
+	desc.ndi_name = s->backup_name;
+	s->standby_receiver = ndi_receiver_acquire(&desc);
+}
+
+// Pre-warms a receiver at the configured bandwidth for a source left at
+// the lowest one by a failover
+static void ndi_source_restore_bandwidth(struct ndi_source *s)
+{
+	s->recv_desc.bandwidth = s->configured_bandwidth;
+	ndi_source_prewarm(s, ndi_receiver_acquire(&s->recv_desc));
+	s->pending_rebuild = true;
+}
+
+void ndi_source_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
 	auto s = (struct ndi_source *)data;
 
-	if (s->running) {
-		s->running = false;
-		pthread_join(s->av_thread, NULL);
+	// Never wait on a settings update from the graphics thread
+	if (pthread_mutex_trylock(&s->receiver_mutex) != 0)
+		return;
+
+	// Also checked during a receiver switch, which failing over cancels
+	if (s->standby_receiver && s->receiver &&
+	    s->recv_desc.bandwidth != NDIlib_recv_bandwidth_audio_only &&
+	    ndi_source_active_lost(s))
+		ndi_source_failover(s);
+
+	if (s->pending_rebuild) {
+		if (ndi_source_pending_done(s)) {
+			ndi_source_promote_pending(s);
+			s->pending_rebuild = false;
+			ndi_clock_reset(&s->clock);
+
+			blog(LOG_INFO, "NDI source '%s' switched receivers",
+			     s->ndi_name);
+		}
+	} else if (!s->bw_auto && s->receiver &&
+		   s->recv_desc.bandwidth != s->configured_bandwidth) {
+		ndi_source_restore_bandwidth(s);
+	} else if (s->bw_auto && s->receiver) {
+		ndi_source_auto_bandwidth(s);
+	}
+
+	if (s->receiver)
+		ndi_source_signal_metadata(s, s->receiver);
+
+	pthread_mutex_unlock(&s->receiver_mutex);
+}
+
+static void ndi_source_release_receiver(struct ndi_source *s)
+{
+	ndi_receiver_release(s->standby_receiver);
+	s->standby_receiver = nullptr;
+	ndi_source_cancel_pending(s);
+
+	if (!s->receiver)
+		return;
+
+	ndi_receiver_disconnect(s->receiver, s);
+
+	pthread_mutex_lock(&s->framesync_mutex);
+	s->ndi_framesync = nullptr;
+	s->framesync_receiver = nullptr;
+	pthread_mutex_unlock(&s->framesync_mutex);
+
+	ndi_receiver_release(s->receiver);
+	s->receiver = nullptr;
+}
+
+static bool ndi_source_same_stream(const struct ndi_receiver_desc *a,
+				   const struct ndi_receiver_desc *b)
+{
+	return a->ndi_name && b->ndi_name &&
+	       strcmp(a->ndi_name, b->ndi_name) == 0 &&
+	       a->bandwidth == b->bandwidth &&
+	       a->color_format == b->color_format &&
+	       a->hw_accel == b->hw_accel && a->framesync == b->framesync;
+}
+
+// Moves the source to a receiver for s->recv_desc. Async sources keep
+// the previous receiver, and so the picture, until the new one delivers
+// video; sync sources keep their last texture anyway.
+static void ndi_source_rebuild_receiver(struct ndi_source *s)
+{
+	ndi_source_cancel_pending(s);
+
+	// Returns at once, the receiver connects in the background
+	struct ndi_receiver *receiver = ndi_receiver_acquire(&s->recv_desc);
+
+	const bool audio_only =
+		(s->recv_desc.bandwidth == NDIlib_recv_bandwidth_audio_only);
+
+	s->on_preview = obs_source_showing(s->source);
+	s->on_program = obs_source_active(s->source);
+
+	if (receiver && s->receiver && !s->is_sync && !audio_only) {
+		ndi_source_prewarm(s, receiver);
+		s->pending_rebuild = true;
+
+		blog(LOG_INFO, "connecting source '%s' to NDI receiver",
+		     s->recv_desc.ndi_name);
+		return;
+	}
+
+	struct ndi_receiver *previous = s->receiver;
+	if (previous)
+		ndi_receiver_disconnect(previous, s);
+
+	pthread_mutex_lock(&s->framesync_mutex);
+	s->ndi_framesync = nullptr;
+	s->framesync_receiver = nullptr;
+	pthread_mutex_unlock(&s->framesync_mutex);
+
+	s->receiver = receiver;
+	ndi_receiver_release(previous);
+	ndi_clock_reset(&s->clock);
+	ndi_source_reset_activity(s);
+
+	if (audio_only) {
+		if (s->is_sync)
+			s->sync_clear_video = true;
+		else
+			obs_source_output_video(s->source,
+						blank_video_frame());
 	}
-	s->running = false;
-	ndiLib->recv_destroy(s->ndi_receiver);
+
+	if (!receiver)
+		return;
+
+	if (s->is_sync) {
+		pthread_mutex_lock(&s->framesync_mutex);
+		// Picked up by sync_tick once the receiver is connected. In
+		// receive ring mode it has no frame sync and is only used for
+		// metadata.
+		s->framesync_receiver = receiver;
+		s->sync_last_video_timestamp = 0;
+		s->sync_audio_remainder = 0.0;
+		s->sync_audio_next_ts = 0;
+		pthread_mutex_unlock(&s->framesync_mutex);
+	}
+
+	if (s->recv_desc.framesync) {
+		blog(LOG_INFO, "started frame sync for source '%s'",
+		     s->recv_desc.ndi_name);
+	} else {
+		ndi_receiver_connect(receiver, s, ndi_source_receive_video,
+				     ndi_source_receive_audio);
+
+		blog(LOG_INFO, "connected source '%s' to NDI receiver",
+		     s->recv_desc.ndi_name);
+	}
+
+	ndi_receiver_set_tally(receiver, s, s->on_preview, s->on_program);
+}
+
+static void ndi_source_sync_pull_video(struct ndi_source *s)
+{
+	NDIlib_video_frame_v2_t video_frame;
+	ndiLib->framesync_capture_video(s->ndi_framesync, &video_frame,
+					NDIlib_frame_format_type_progressive);
+
+	// The frame sync hands out the most recent frame on every call:
+	// only re-upload when the sender actually produced a new one
+	if (video_frame.p_data &&
+	    video_frame.timestamp != s->sync_last_video_timestamp) {
+		obs_source_frame obs_video_frame = {};
+		const uint64_t start = os_gettime_ns();
+		if (ndi_source_fill_video_frame(s, &video_frame,
+						&obs_video_frame)) {
+			ndi_source_shape_video(s, &obs_video_frame);
+
+			obs_enter_graphics();
+			frame_render_upload(s->render, &obs_video_frame);
+			obs_leave_graphics();
+
+			ndi_scaler_release(s->scaler);
+
+			ndi_stats_add_convert(&s->stats,
+					      os_gettime_ns() - start);
+			ndi_stats_add(s->stats.video_frames);
+		} else {
+			ndi_stats_add(s->stats.video_discarded);
+		}
+		ndi_source_put_conv_frame(s);
+		s->sync_last_video_timestamp = video_frame.timestamp;
+	}
+
+	ndiLib->framesync_free_video(s->ndi_framesync, &video_frame);
+}
+
+// Frame sync of a connected receiver, once it's known. framesync_mutex
+// must be held.
+static void ndi_source_sync_resolve(struct ndi_source *s)
+{
+	if (!s->ndi_framesync && s->framesync_receiver)
+		s->ndi_framesync =
+			ndi_receiver_get_framesync(s->framesync_receiver);
+}
+
+// Shared tick of a genlock group, possibly from another member's tick
+static int64_t ndi_source_genlock_pull(void *param)
+{
+	auto s = (struct ndi_source *)param;
+
+	pthread_mutex_lock(&s->framesync_mutex);
+	ndi_source_sync_resolve(s);
+	if (s->ndi_framesync)
+		ndi_source_sync_pull_video(s);
+	const int64_t timestamp = s->sync_last_video_timestamp;
+	pthread_mutex_unlock(&s->framesync_mutex);
+
+	if (!timestamp || timestamp == NDIlib_recv_timestamp_undefined)
+		return -1;
+	return timestamp * 100;
+}
+
+// Only a change of stream (name, bandwidth, color format, hardware
+// acceleration) goes through a new receiver. Everything else is applied
+// to the running one.
+void ndi_source_update(void *data, obs_data_t *settings)
+{
+	auto s = (struct ndi_source *)data;
 
 	bool hwAccelEnabled = obs_data_get_bool(settings, PROP_HW_ACCEL);
 
@@ -489,12 +1743,54 @@ void ndi_source_update(void *data, obs_data_t *settings)
 		}
 	}
 
-	NDIlib_recv_create_v3_t recv_desc;
-	recv_desc.source_to_connect_to.p_ndi_name =
-		obs_data_get_string(settings, PROP_SOURCE);
-	recv_desc.allow_video_fields = true;
-	recv_desc.color_format = NDIlib_recv_color_format_UYVY_BGRA;
+	pthread_mutex_lock(&s->receiver_mutex);
 
+	ndi_receiver_desc recv_desc = {};
+	recv_desc.ndi_name = obs_data_get_string(settings, PROP_SOURCE);
+	recv_desc.color_format = NDIlib_recv_color_format_UYVY_BGRA;
+	if (!s->is_sync) {
+		switch (obs_data_get_int(settings, PROP_COLOR_FORMAT)) {
+#if LIBOBS_API_VER >= MAKE_SEMANTIC_VERSION(28, 0, 0)
+		// "best" delivers P216/PA16 for high bit depth senders, and
+		// UYVY/UYVA for 8-bit ones, without any downconversion inside
+		// the SDK
+		case PROP_COLOR_FORMAT_HIGH_BIT_DEPTH:
+			recv_desc.color_format = NDIlib_recv_color_format_best;
+			break;
+#endif
+		// UYVY, or UYVA for senders with alpha instead of BGRA
+		case PROP_COLOR_FORMAT_FAST:
+			recv_desc.color_format =
+				NDIlib_recv_color_format_fastest;
+			break;
+		}
+	}
+	// Sync sources in receive ring mode get frames pushed like async
+	// sources, from a regular (shareable) receiver
+	const bool ring_mode = s->is_sync &&
+			       obs_data_get_int(settings, PROP_SYNC_DELIVERY) ==
+				       PROP_SYNC_DELIVERY_RING;
+
+	recv_desc.hw_accel = hwAccelEnabled;
+	recv_desc.framesync = s->is_sync && !ring_mode;
+	recv_desc.idle_timeout_ms =
+		(uint32_t)obs_data_get_int(settings, PROP_IDLE_WAIT);
+
+	// Frame sync receivers don't queue
+	if (!recv_desc.framesync)
+		recv_desc.max_video_queue =
+			(uint32_t)obs_data_get_int(settings, PROP_MAX_QUEUE);
+
+	const char *thread_cpus =
+		obs_data_get_string(settings, PROP_THREAD_CPUS);
+	if (!ndi_thread_parse_cpus(thread_cpus, &recv_desc.placement.cpus))
+		blog(LOG_WARNING, "invalid CPU list '%s' for NDI source '%s'",
+		     thread_cpus, recv_desc.ndi_name);
+	recv_desc.placement.priority = (enum ndi_thread_priority)
+		obs_data_get_int(settings, PROP_THREAD_PRIORITY);
+
+	const bool was_bw_auto = s->bw_auto;
+	s->bw_auto = false;
 	switch (obs_data_get_int(settings, PROP_BANDWIDTH)) {
 	case PROP_BW_HIGHEST:
 	default:
@@ -503,20 +1799,45 @@ void ndi_source_update(void *data, obs_data_t *settings)
 	case PROP_BW_LOWEST:
 		recv_desc.bandwidth = NDIlib_recv_bandwidth_lowest;
 		break;
+	case PROP_BW_AUTO:
+		// Frame sync receivers aren't shared and can't be pre-warmed
+		s->bw_auto = !s->is_sync;
+		if (s->bw_auto && was_bw_auto && s->receiver) {
+			// Stay wherever automatic bandwidth currently is
+			recv_desc.bandwidth = s->recv_desc.bandwidth;
+			break;
+		}
+		s->bw_hidden_since = 0;
+		recv_desc.bandwidth = (!s->is_sync &&
+				       !obs_source_showing(s->source))
+					      ? NDIlib_recv_bandwidth_lowest
+					      : NDIlib_recv_bandwidth_highest;
+		break;
 	case PROP_BW_AUDIO_ONLY:
 		recv_desc.bandwidth = NDIlib_recv_bandwidth_audio_only;
-		obs_source_output_video(s->source, blank_video_frame());
 		break;
 	}
 
-	s->sync_mode = (int)obs_data_get_int(settings, PROP_SYNC);
+	const int previous_sync_mode = s->sync_mode;
+	int sync_mode = (int)obs_data_get_int(settings, PROP_SYNC);
 	// if sync mode is set to the unsupported "Internal" mode, set it
 	// to "Source Timing" mode and apply that change to the settings data
-	if (s->sync_mode == PROP_SYNC_INTERNAL) {
-		s->sync_mode = PROP_SYNC_NDI_TIMESTAMP;
+	if (sync_mode == PROP_SYNC_INTERNAL) {
+		sync_mode = PROP_SYNC_NDI_TIMESTAMP;
 		obs_data_set_int(settings, PROP_SYNC,
 				 PROP_SYNC_NDI_TIMESTAMP);
 	}
+	s->sync_mode = sync_mode;
+
+	// The receive ring picks frames by OBS time, which needs sender
+	// times mapped onto it
+	const bool clock_recovery =
+		ring_mode || (obs_data_get_bool(settings, PROP_CLOCK_RECOVERY) &&
+			      !s->is_sync);
+	if (clock_recovery != s->clock_recovery ||
+	    sync_mode != previous_sync_mode)
+		ndi_clock_reset(&s->clock);
+	s->clock_recovery = clock_recovery;
 
 	s->yuv_range = prop_to_range_type(
 		(int)obs_data_get_int(settings, PROP_YUV_RANGE));
@@ -525,96 +1846,438 @@ void ndi_source_update(void *data, obs_data_t *settings)
 
 	const bool is_unbuffered =
 		(obs_data_get_int(settings, PROP_LATENCY) == PROP_LATENCY_LOW);
-	obs_source_set_async_unbuffered(s->source, is_unbuffered);
+	if (!s->is_sync)
+		obs_source_set_async_unbuffered(s->source, is_unbuffered);
 
 	s->audio_enabled = obs_data_get_bool(settings, PROP_AUDIO);
 
-	s->ndi_receiver = ndiLib->recv_create_v3(&recv_desc);
-	if (s->ndi_receiver) {
-		if (hwAccelEnabled) {
-			NDIlib_metadata_frame_t hwAccelMetadata;
-			hwAccelMetadata.p_data =
-				(char *)"<ndi_hwaccel enabled=\"true\"/>";
-			ndiLib->recv_send_metadata(s->ndi_receiver,
-						   &hwAccelMetadata);
-		}
+	struct ndi_audio_matrix audio_matrix;
+	const char *matrix_spec =
+		obs_data_get_string(settings, PROP_AUDIO_MATRIX);
+	if (!ndi_audio_matrix_parse(&audio_matrix, matrix_spec))
+		blog(LOG_WARNING,
+		     "invalid audio channel matrix '%s', using the first "
+		     "8 channels",
+		     matrix_spec);
+
+	// Frame sync sources already get audio at the OBS rate
+	const bool audio_resample =
+		obs_data_get_bool(settings, PROP_AUDIO_RESAMPLE) && !s->is_sync;
+
+	pthread_mutex_lock(&s->audio_mutex);
+	s->audio_matrix = audio_matrix;
+	s->audio_clamp_warned = false;
+	s->audio_resample = audio_resample;
+	if (!audio_resample) {
+		audio_resampler_destroy(s->resampler);
+		s->resampler = nullptr;
+	}
+	pthread_mutex_unlock(&s->audio_mutex);
+	s->deinterlace_mode = (enum ndi_deinterlace_mode)obs_data_get_int(
+		settings, PROP_DEINTERLACE);
+	s->crop_left = (uint32_t)obs_data_get_int(settings, PROP_CROP_LEFT);
+	s->crop_top = (uint32_t)obs_data_get_int(settings, PROP_CROP_TOP);
+	s->crop_right = (uint32_t)obs_data_get_int(settings, PROP_CROP_RIGHT);
+	s->crop_bottom =
+		(uint32_t)obs_data_get_int(settings, PROP_CROP_BOTTOM);
+	s->target_width =
+		(uint32_t)obs_data_get_int(settings, PROP_TARGET_WIDTH);
+	s->target_height =
+		(uint32_t)obs_data_get_int(settings, PROP_TARGET_HEIGHT);
+
+	if (ring_mode != s->ring_mode) {
+		s->ring_mode = ring_mode;
+		ndi_source_ring_clear(s);
+	}
 
-		s->running = true;
-		pthread_create(&s->av_thread, nullptr,
-			       ndi_source_poll_audio_video, data);
+	// Sync sources have no failover. A source that failed over stays on
+	// the backup as long as the settings name the same two senders: the
+	// primary remains the standby and takes over again once the backup
+	// is lost, if it's back by then.
+	const char *backup =
+		s->is_sync ? ""
+			   : obs_data_get_string(settings, PROP_BACKUP_SOURCE);
+	const bool failed_over =
+		s->failed_over && s->ndi_name && s->backup_name &&
+		strcmp(recv_desc.ndi_name, s->backup_name) == 0 &&
+		strcmp(backup, s->ndi_name) == 0;
+	if (failed_over) {
+		const char *primary = recv_desc.ndi_name;
+		recv_desc.ndi_name = backup;
+		backup = primary;
+	}
+	s->failed_over = failed_over;
+
+	// The bandwidth a failover left the active receiver at is no change
+	struct ndi_receiver_desc active = s->recv_desc;
+	if (!was_bw_auto)
+		active.bandwidth = s->configured_bandwidth;
+
+	// The idle timeout only applies to newly created receivers. A
+	// receiver that failed to connect gets another attempt.
+	const bool rebuild =
+		!s->receiver ||
+		ndi_receiver_get_state(s->receiver) == NDI_RECEIVER_FAILED ||
+		!ndi_source_same_stream(&recv_desc, &active);
+	s->configured_bandwidth = recv_desc.bandwidth;
+	if (rebuild) {
+		bfree(s->ndi_name);
+		s->ndi_name = bstrdup(recv_desc.ndi_name);
+		recv_desc.ndi_name = s->ndi_name;
+		s->recv_desc = recv_desc;
+		ndi_source_rebuild_receiver(s);
+	} else {
+		if (!s->bw_auto && !s->pending_rebuild) {
+			// Drop a bandwidth switch left over from automatic mode
+			ndi_source_cancel_pending(s);
+		}
 
-		blog(LOG_INFO, "started A/V threads for source '%s'",
-		     recv_desc.source_to_connect_to.p_ndi_name);
+		s->recv_desc.placement = recv_desc.placement;
+		s->recv_desc.max_video_queue = recv_desc.max_video_queue;
+		ndi_receiver_set_placement(s->receiver, &recv_desc.placement);
+		ndi_receiver_set_max_video_queue(s->receiver,
+						 recv_desc.max_video_queue);
+		if (s->pending_receiver) {
+			ndi_receiver_set_placement(s->pending_receiver,
+						   &recv_desc.placement);
+			ndi_receiver_set_max_video_queue(
+				s->pending_receiver, recv_desc.max_video_queue);
+		}
+	}
 
-		// Update tally status
-		s->tally.on_preview = obs_source_showing(s->source);
-		s->tally.on_program = obs_source_active(s->source);
-		ndiLib->recv_set_tally(s->ndi_receiver, &s->tally);
-	} else {
-		blog(LOG_ERROR, "can't create a receiver for NDI source '%s'",
-		     recv_desc.source_to_connect_to.p_ndi_name);
+	s->failover_timeout_ns =
+		(uint64_t)obs_data_get_int(settings, PROP_FAILOVER_TIMEOUT) *
+		1000000ULL;
+	if (rebuild || strcmp(backup, s->backup_name ? s->backup_name : ""))
+		ndi_source_set_standby(s, backup);
+
+	// Only frame sync video can be pulled on a shared tick
+	const char *genlock_group =
+		recv_desc.framesync
+			? obs_data_get_string(settings, PROP_GENLOCK_GROUP)
+			: "";
+	if (strcmp(genlock_group, s->genlock_group ? s->genlock_group : "")) {
+		ndi_genlock_join(genlock_group, s, ndi_source_genlock_pull);
+		bfree(s->genlock_group);
+		s->genlock_group = bstrdup(genlock_group);
 	}
+
+	pthread_mutex_unlock(&s->receiver_mutex);
 }
 
 void ndi_source_shown(void *data)
 {
 	auto s = (struct ndi_source *)data;
 
-	if (s->ndi_receiver) {
-		s->tally.on_preview = true;
-		ndiLib->recv_set_tally(s->ndi_receiver, &s->tally);
-	}
+	s->on_preview = true;
+	ndi_source_set_receiver_tally(s);
 }
 
 void ndi_source_hidden(void *data)
 {
 	auto s = (struct ndi_source *)data;
 
-	if (s->ndi_receiver) {
-		s->tally.on_preview = false;
-		ndiLib->recv_set_tally(s->ndi_receiver, &s->tally);
-	}
+	s->on_preview = false;
+	ndi_source_set_receiver_tally(s);
 }
 
 void ndi_source_activated(void *data)
 {
 	auto s = (struct ndi_source *)data;
 
-	if (s->ndi_receiver) {
-		s->tally.on_program = true;
-		ndiLib->recv_set_tally(s->ndi_receiver, &s->tally);
-	}
+	s->on_program = true;
+	ndi_source_set_receiver_tally(s);
 }
 
 void ndi_source_deactivated(void *data)
 {
 	auto s = (struct ndi_source *)data;
 
-	if (s->ndi_receiver) {
-		s->tally.on_program = false;
-		ndiLib->recv_set_tally(s->ndi_receiver, &s->tally);
+	s->on_program = false;
+	ndi_source_set_receiver_tally(s);
+}
+
+// Runs on the stats thread
+static void ndi_source_stats_snapshot(void *data, obs_data_t *stats)
+{
+	auto s = (struct ndi_source *)data;
+
+	obs_data_set_string(stats, "name", obs_source_get_name(s->source));
+
+	pthread_mutex_lock(&s->receiver_mutex);
+	obs_data_set_string(stats, "ndi_name", s->ndi_name ? s->ndi_name : "");
+	ndi_stats_fill(stats, &s->stats,
+		       ndi_receiver_get_instance(s->receiver));
+	// A total of the receiver, like the sdk_* figures
+	obs_data_set_int(stats, "sdk_stale_video_dropped",
+			 (long long)ndi_receiver_get_stale_dropped(s->receiver));
+	obs_data_set_int(
+		stats, "frame_pool_allocations",
+		(long long)ndi_frame_pool_get_allocations(s->frame_pool));
+	pthread_mutex_unlock(&s->receiver_mutex);
+
+	struct ndi_genlock_phase phase;
+	if (ndi_genlock_get_phase(s, &phase)) {
+		obs_data_set_int(stats, "genlock_members", phase.members);
+		obs_data_set_int(stats, "genlock_phase_error_ns",
+				 phase.phase_error_ns);
+		obs_data_set_int(stats, "genlock_spread_ns", phase.spread_ns);
 	}
 }
 
+static void ndi_source_get_stats_proc(void *data, calldata_t *cd)
+{
+	obs_data_t *stats = obs_data_create();
+	ndi_source_stats_snapshot(data, stats);
+	calldata_set_string(cd, "stats", obs_data_get_json(stats));
+	obs_data_release(stats);
+}
+
+static void ndi_source_init_stats(struct ndi_source *s)
+{
+	proc_handler_t *ph = obs_source_get_proc_handler(s->source);
+	proc_handler_add(ph, "void get_stats(out string stats)",
+			 ndi_source_get_stats_proc, s);
+	ndi_stats_register(s, ndi_source_stats_snapshot);
+}
+
+// Returns the metadata frames from number 'since' on, as far as the
+// receiver still has them, and the number to ask for next time. Numbers
+// start over when the source switches receivers.
+static void ndi_source_get_metadata_proc(void *data, calldata_t *cd)
+{
+	auto s = (struct ndi_source *)data;
+	const long long since = calldata_int(cd, "since");
+
+	obs_data_array_t *frames = obs_data_array_create();
+	auto frame = (struct ndi_metadata_frame *)bmalloc(
+		sizeof(struct ndi_metadata_frame));
+
+	pthread_mutex_lock(&s->receiver_mutex);
+	const uint64_t count = ndi_receiver_metadata_count(s->receiver);
+	uint64_t index = since > 0 ? (uint64_t)since : 0;
+	if (index > count || count - index > NDI_METADATA_RING_SIZE)
+		index = count > NDI_METADATA_RING_SIZE
+				? count - NDI_METADATA_RING_SIZE
+				: 0;
+
+	for (; index < count; ++index) {
+		if (!ndi_receiver_read_metadata(s->receiver, index, frame))
+			continue;
+
+		obs_data_t *item = obs_data_create();
+		obs_data_set_int(item, "index", (long long)index);
+		obs_data_set_int(item, "timecode", frame->timecode);
+		obs_data_set_string(item, "data", frame->data);
+		obs_data_array_push_back(frames, item);
+		obs_data_release(item);
+	}
+	pthread_mutex_unlock(&s->receiver_mutex);
+
+	obs_data_t *result = obs_data_create();
+	obs_data_set_int(result, "next", (long long)count);
+	obs_data_set_array(result, "frames", frames);
+	calldata_set_string(cd, "metadata", obs_data_get_json(result));
+
+	obs_data_release(result);
+	obs_data_array_release(frames);
+	bfree(frame);
+}
+
+static void ndi_source_init_metadata(struct ndi_source *s)
+{
+	signal_handler_add(
+		obs_source_get_signal_handler(s->source),
+		"void ndi_metadata(ptr source, string metadata, int timecode)");
+	proc_handler_add(obs_source_get_proc_handler(s->source),
+			 "void get_metadata(in int since, out string metadata)",
+			 ndi_source_get_metadata_proc, s);
+}
+
 void *ndi_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	auto s = (struct ndi_source *)bzalloc(sizeof(struct ndi_source));
 	s->source = source;
-	s->running = false;
-	s->perf_token = NULL;
+	s->deinterlacer = ndi_deinterlacer_create();
+	pthread_mutex_init(&s->receiver_mutex, NULL);
+	pthread_mutex_init(&s->video_mutex, NULL);
+	pthread_mutex_init(&s->audio_mutex, NULL);
+	pthread_mutex_init(&s->framesync_mutex, NULL);
+	pthread_mutex_init(&s->ring_mutex, NULL);
+	s->frame_pool = ndi_frame_pool_create();
+	s->scaler = ndi_scaler_create();
+	s->ring_pool = ndi_frame_pool_create();
+	ndi_clock_init(&s->clock);
 	ndi_source_update(s, settings);
+	ndi_source_init_stats(s);
+	ndi_source_init_metadata(s);
+	return s;
+}
+
+void *ndi_source_sync_create(obs_data_t *settings, obs_source_t *source)
+{
+	auto s = (struct ndi_source *)bzalloc(sizeof(struct ndi_source));
+	s->source = source;
+	s->is_sync = true;
+	// Receive ring mode shares the video path of async sources
+	s->deinterlacer = ndi_deinterlacer_create();
+	pthread_mutex_init(&s->receiver_mutex, NULL);
+	pthread_mutex_init(&s->video_mutex, NULL);
+	pthread_mutex_init(&s->audio_mutex, NULL);
+	pthread_mutex_init(&s->framesync_mutex, NULL);
+	pthread_mutex_init(&s->ring_mutex, NULL);
+	s->frame_pool = ndi_frame_pool_create();
+	s->scaler = ndi_scaler_create();
+	s->ring_pool = ndi_frame_pool_create();
+	ndi_clock_init(&s->clock);
+
+	obs_enter_graphics();
+	s->render = frame_render_create();
+	obs_leave_graphics();
+
+	ndi_source_update(s, settings);
+	ndi_source_init_stats(s);
+	ndi_source_init_metadata(s);
 	return s;
 }
 
 void ndi_source_destroy(void *data)
 {
 	auto s = (struct ndi_source *)data;
-	s->running = false;
-	pthread_join(s->av_thread, NULL);
-	ndiLib->recv_destroy(s->ndi_receiver);
+	ndi_stats_unregister(s);
+	ndi_genlock_leave(s);
+	ndi_source_release_receiver(s);
+
+	if (s->render) {
+		obs_enter_graphics();
+		frame_render_destroy(s->render);
+		obs_leave_graphics();
+	}
+
+	pthread_mutex_destroy(&s->receiver_mutex);
+	pthread_mutex_destroy(&s->video_mutex);
+	pthread_mutex_destroy(&s->audio_mutex);
+	pthread_mutex_destroy(&s->framesync_mutex);
+	ndi_clock_free(&s->clock);
+	ndi_deinterlacer_destroy(s->deinterlacer);
+	bfree(s->ndi_name);
+	bfree(s->genlock_group);
+	bfree(s->backup_name);
+	audio_resampler_destroy(s->resampler);
+	bfree(s->audio_buffer);
+	ndi_source_put_conv_frame(s);
+	ndi_scaler_destroy(s->scaler);
+	ndi_frame_pool_destroy(s->frame_pool);
+	ndi_source_ring_clear(s);
+	ndi_frame_pool_destroy(s->ring_pool);
+	pthread_mutex_destroy(&s->ring_mutex);
 	bfree(s);
 }
 
+static void ndi_source_sync_pull_audio(struct ndi_source *s, float seconds)
+{
+	struct obs_audio_info oai;
+	if (!obs_get_audio_info(&oai))
+		return;
+
+	// Request exactly the number of samples OBS consumed since the last
+	// tick. The frame sync resamples the incoming audio to follow our
+	// clock, so the carried remainder keeps the long-term rate exact.
+	s->sync_audio_remainder += (double)seconds * oai.samples_per_sec;
+	const int no_samples = (int)s->sync_audio_remainder;
+	if (no_samples <= 0)
+		return;
+	s->sync_audio_remainder -= no_samples;
+
+	NDIlib_audio_frame_v3_t audio_frame;
+	ndiLib->framesync_capture_audio_v2(s->ndi_framesync, &audio_frame,
+					   (int)oai.samples_per_sec, 0,
+					   no_samples);
+
+	if (s->audio_enabled && audio_frame.p_data &&
+	    audio_frame.no_channels > 0) {
+		const uint64_t duration = (uint64_t)audio_frame.no_samples *
+					  1000000000ULL / oai.samples_per_sec;
+		const uint64_t now = os_gettime_ns();
+		const uint64_t ts = now - duration;
+
+		// Keep the timeline gapless unless we drifted too far away
+		// from the system clock (source switch, long stall...)
+		if (!s->sync_audio_next_ts ||
+		    (ts > s->sync_audio_next_ts
+			     ? ts - s->sync_audio_next_ts
+			     : s->sync_audio_next_ts - ts) > 100000000ULL)
+			s->sync_audio_next_ts = ts;
+
+		obs_source_audio obs_audio_frame = {};
+		obs_audio_frame.samples_per_sec = audio_frame.sample_rate;
+		obs_audio_frame.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		obs_audio_frame.frames = audio_frame.no_samples;
+		obs_audio_frame.timestamp = s->sync_audio_next_ts;
+
+		pthread_mutex_lock(&s->audio_mutex);
+		ndi_source_map_audio(s, &audio_frame, &obs_audio_frame);
+		obs_source_output_audio(s->source, &obs_audio_frame);
+		pthread_mutex_unlock(&s->audio_mutex);
+		s->sync_audio_next_ts += duration;
+		ndi_stats_add(s->stats.audio_frames);
+	}
+
+	ndiLib->framesync_free_audio_v2(s->ndi_framesync, &audio_frame);
+}
+
+void ndi_source_sync_tick(void *data, float seconds)
+{
+	auto s = (struct ndi_source *)data;
+
+	// Members of a genlock group get their video pulled by the group
+	const bool genlocked = ndi_genlock_tick(s, obs_get_video_frame_time());
+
+	pthread_mutex_lock(&s->framesync_mutex);
+
+	if (s->sync_clear_video) {
+		obs_enter_graphics();
+		frame_render_clear(s->render);
+		obs_leave_graphics();
+		ndi_source_ring_clear(s);
+		s->sync_clear_video = false;
+	}
+
+	ndi_source_sync_resolve(s);
+
+	if (s->ndi_framesync) {
+		if (!genlocked)
+			ndi_source_sync_pull_video(s);
+		ndi_source_sync_pull_audio(s, seconds);
+	}
+
+	if (s->framesync_receiver)
+		ndi_source_signal_metadata(s, s->framesync_receiver);
+
+	pthread_mutex_unlock(&s->framesync_mutex);
+}
+
+void ndi_source_sync_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+	auto s = (struct ndi_source *)data;
+	if (s->ring_mode)
+		ndi_source_ring_upload(s);
+	frame_render_draw(s->render);
+}
+
+uint32_t ndi_source_sync_get_width(void *data)
+{
+	auto s = (struct ndi_source *)data;
+	return frame_render_get_width(s->render);
+}
+
+uint32_t ndi_source_sync_get_height(void *data)
+{
+	auto s = (struct ndi_source *)data;
+	return frame_render_get_height(s->render);
+}
+
 struct obs_source_info create_ndi_source_info() {
 	struct obs_source_info ndi_source_info = {};
 	ndi_source_info.id = "ndi_source";
@@ -632,6 +2295,31 @@ struct obs_source_info create_ndi_source_info() {
 	ndi_source_info.deactivate = ndi_source_deactivated;
 	ndi_source_info.create = ndi_source_create;
 	ndi_source_info.destroy = ndi_source_destroy;
+	ndi_source_info.video_tick = ndi_source_tick;
+
+	return ndi_source_info;
+}
+
+// Same receiver as "ndi_source", but registered as a synchronous video
+// source: libobs fixes the async flag per source type, so the pull mode
+// needs its own type. Frames come out of an NDI frame sync on the OBS
+// graphics clock and are drawn from our own textures, which skips the
+// async frame queue and its buffering. In receive ring mode, frames are
+// pushed by a regular receiver instead and the newest one is uploaded at
+// render time.
+struct obs_source_info create_ndi_sync_source_info()
+{
+	struct obs_source_info ndi_source_info = create_ndi_source_info();
+	ndi_source_info.id = "ndi_source_sync";
+	ndi_source_info.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_AUDIO |
+				       OBS_SOURCE_CUSTOM_DRAW |
+				       OBS_SOURCE_DO_NOT_DUPLICATE;
+	ndi_source_info.get_name = ndi_source_sync_getname;
+	ndi_source_info.create = ndi_source_sync_create;
+	ndi_source_info.video_tick = ndi_source_sync_tick;
+	ndi_source_info.video_render = ndi_source_sync_render;
+	ndi_source_info.get_width = ndi_source_sync_get_width;
+	ndi_source_info.get_height = ndi_source_sync_get_height;
 
 	return ndi_source_info;
 }
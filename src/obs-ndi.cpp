@@ -34,6 +34,10 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <sstream>
 
 #include "obs-ndi.h"
+#include "ndi-receiver-pool.h"
+#include "ndi-stats.h"
+#include "ndi-discovery.h"
+#include "ndi-thread-placement.h"
 #include "main-output.h"
 #include "preview-output.h"
 
@@ -46,6 +50,9 @@ const NDIlib_v5 *ndiLib = nullptr;
 extern struct obs_source_info create_ndi_source_info();
 struct obs_source_info ndi_source_info;
 
+extern struct obs_source_info create_ndi_sync_source_info();
+struct obs_source_info ndi_sync_source_info;
+
 extern struct obs_output_info create_ndi_output_info();
 struct obs_output_info ndi_output_info;
 
@@ -96,14 +103,20 @@ bool obs_module_load(void) {
 
 	blog(LOG_INFO, "NDI library initialized successfully (%s)", ndiLib->version());
 
+	ndi_thread_placement_init();
+
 	NDIlib_find_create_t find_desc = {0};
 	find_desc.show_local_sources = true;
 	find_desc.p_groups = NULL;
 	ndi_finder = ndiLib->find_create_v2(&find_desc);
+	ndi_discovery_init(ndi_finder);
 
   ndi_source_info = create_ndi_source_info();
   obs_register_source(&ndi_source_info);
 
+  ndi_sync_source_info = create_ndi_sync_source_info();
+  obs_register_source(&ndi_sync_source_info);
+
 	ndi_filter_info = create_ndi_filter_info();
   obs_register_source(&ndi_filter_info);
 
@@ -113,6 +126,8 @@ bool obs_module_load(void) {
   alpha_filter_info = create_alpha_filter_info();
   obs_register_source(&alpha_filter_info);
 
+  ndi_stats_init();
+
   return true;
 }
 
@@ -121,6 +136,9 @@ void obs_module_unload()
     blog(LOG_INFO, "goodbye !");
 
     if (ndiLib) {
+	    ndi_stats_shutdown();
+	    ndi_discovery_shutdown();
+	    ndi_receiver_pool_shutdown();
 	    ndiLib->find_destroy(ndi_finder);
 	    ndiLib->destroy();
     }